@@ -0,0 +1,188 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mm_types.h"
+#include "mm_debug.h"
+#include "mm_error.h"
+#include "mm_sound_pool.h"
+
+/* Blocks are aligned for any type the players keep in them */
+#define MM_SOUND_POOL_ALIGN		16
+
+static mm_sound_pool_t *g_pools = NULL;
+static pthread_mutex_t g_pools_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Called with pool->lock held */
+static int _mm_sound_pool_reserve(mm_sound_pool_t *pool)
+{
+	unsigned int i;
+
+	pool->block_size = (pool->block_size + MM_SOUND_POOL_ALIGN - 1) & ~(size_t)(MM_SOUND_POOL_ALIGN - 1);
+	pool->blocks = (char *)malloc(pool->block_size * pool->count);
+	if (pool->blocks == NULL) {
+		debug_error("pool [%s] : reserve %u x %u bytes fail\n", pool->name, pool->count, (unsigned int)pool->block_size);
+		return -1;
+	}
+
+	pool->free_list = NULL;
+	for (i = pool->count; i > 0; i--) {
+		void **block = (void **)(pool->blocks + (i - 1) * pool->block_size);
+		*block = pool->free_list;
+		pool->free_list = block;
+	}
+	pool->stats.block_size = pool->block_size;
+	pool->stats.count = pool->count;
+
+	debug_msg("pool [%s] : %u blocks of %u bytes\n", pool->name, pool->count, (unsigned int)pool->block_size);
+	return 0;
+}
+
+static int _mm_sound_pool_owns(const mm_sound_pool_t *pool, const void *ptr)
+{
+	return pool->blocks && (const char *)ptr >= pool->blocks &&
+		(const char *)ptr < pool->blocks + pool->block_size * pool->count;
+}
+
+EXPORT_API
+void *mm_sound_pool_alloc(mm_sound_pool_t *pool, size_t size)
+{
+	void **block = NULL;
+	unsigned int in_use;
+	int reserved = 0;
+
+	if (pool == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->blocks == NULL && pool->count)
+		reserved = (_mm_sound_pool_reserve(pool) == 0);
+
+	if (size <= pool->block_size && pool->free_list) {
+		block = (void **)pool->free_list;
+		pool->free_list = *block;
+		pool->stats.allocs++;
+		if (++pool->stats.in_use > pool->stats.peak)
+			pool->stats.peak = pool->stats.in_use;
+	} else {
+		pool->stats.fallbacks++;
+	}
+	in_use = pool->stats.in_use;
+	pthread_mutex_unlock(&pool->lock);
+
+	/* Listed for mm_sound_pool_dump(), outside of pool->lock which the dump takes second */
+	if (reserved) {
+		pthread_mutex_lock(&g_pools_lock);
+		pool->next = g_pools;
+		g_pools = pool;
+		pthread_mutex_unlock(&g_pools_lock);
+	}
+
+	if (block == NULL) {
+		debug_warning("pool [%s] : %u bytes from malloc (block %u, %u/%u used)\n", pool->name,
+				(unsigned int)size, (unsigned int)pool->block_size, in_use, pool->count);
+		return malloc(size);
+	}
+	return block;
+}
+
+EXPORT_API
+void mm_sound_pool_free(mm_sound_pool_t *pool, void *ptr)
+{
+	if (pool == NULL || ptr == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	if (_mm_sound_pool_owns(pool, ptr)) {
+		*(void **)ptr = pool->free_list;
+		pool->free_list = ptr;
+		pool->stats.in_use--;
+		pool->stats.frees++;
+		ptr = NULL;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	/* Not a block : it came from the malloc() fallback */
+	if (ptr)
+		free(ptr);
+}
+
+/* Releases the blocks of a pool, none of them may be in use */
+EXPORT_API
+void mm_sound_pool_destroy(mm_sound_pool_t *pool)
+{
+	mm_sound_pool_t **pos;
+
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&g_pools_lock);
+	for (pos = &g_pools; *pos; pos = &(*pos)->next) {
+		if (*pos == pool) {
+			*pos = pool->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&g_pools_lock);
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->stats.in_use)
+		debug_error("pool [%s] : destroyed with %u blocks in use\n", pool->name, pool->stats.in_use);
+	free(pool->blocks);
+	pool->blocks = NULL;
+	pool->free_list = NULL;
+	pool->next = NULL;
+	pthread_mutex_unlock(&pool->lock);
+}
+
+EXPORT_API
+int mm_sound_pool_get_stats(mm_sound_pool_t *pool, mm_sound_pool_stats_t *stats)
+{
+	if (pool == NULL || stats == NULL)
+		return MM_ERROR_INVALID_ARGUMENT;
+
+	pthread_mutex_lock(&pool->lock);
+	memcpy(stats, &pool->stats, sizeof(mm_sound_pool_stats_t));
+	pthread_mutex_unlock(&pool->lock);
+
+	return MM_ERROR_NONE;
+}
+
+/* Logs every pool which served an allocation */
+EXPORT_API
+void mm_sound_pool_dump(void)
+{
+	mm_sound_pool_stats_t stats;
+	mm_sound_pool_t *pool;
+
+	pthread_mutex_lock(&g_pools_lock);
+	for (pool = g_pools; pool; pool = pool->next) {
+		mm_sound_pool_get_stats(pool, &stats);
+		debug_msg("***** [Pool %s] %u x %u bytes, in use %u, peak %u, allocs %llu, fallbacks %llu, frees %llu\n",
+				pool->name, stats.count, stats.block_size, stats.in_use, stats.peak,
+				stats.allocs, stats.fallbacks, stats.frees);
+	}
+	pthread_mutex_unlock(&g_pools_lock);
+}
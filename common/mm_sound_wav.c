@@ -0,0 +1,232 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <string.h>
+
+#include "mm_types.h"
+#include "mm_error.h"
+#include "mm_sound_wav.h"
+
+#define WAV_FOURCC(a, b, c, d)	((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+#define WAV_RIFF_ID				WAV_FOURCC('R', 'I', 'F', 'F')
+#define WAV_WAVE_ID				WAV_FOURCC('W', 'A', 'V', 'E')
+#define WAV_FMT_ID				WAV_FOURCC('f', 'm', 't', ' ')
+#define WAV_DATA_ID				WAV_FOURCC('d', 'a', 't', 'a')
+#define WAV_SMPL_ID				WAV_FOURCC('s', 'm', 'p', 'l')
+
+#define WAV_FMT_SIZE			16		/* PCM format chunk */
+#define WAV_FMT_EXT_SIZE		40		/* WAVEFORMATEXTENSIBLE */
+#define WAV_SMPL_SIZE			36		/* smpl chunk without its loops */
+#define WAV_SMPL_LOOP_SIZE		24
+#define WAV_SMPL_LOOP_FORWARD	0
+
+/* Tail of KSDATAFORMAT_SUBTYPE_PCM and _IEEE_FLOAT, after the format code */
+static const unsigned char g_subformat_tail[14] = {
+	0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
+
+static inline uint16_t _wav_le16(const unsigned char *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t _wav_le32(const unsigned char *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int _wav_parse_fmt(const unsigned char *fmt, uint32_t len, mm_sound_wav_info_t *info)
+{
+	uint16_t format = _wav_le16(fmt);
+
+	info->channels = _wav_le16(fmt + 2);
+	info->samplerate = _wav_le32(fmt + 4);
+	info->block_align = _wav_le16(fmt + 12);
+	info->bits = _wav_le16(fmt + 14);
+	info->valid_bits = info->bits;
+	info->channel_mask = 0;
+
+	if (format == MM_SOUND_WAV_FORMAT_EXTENSIBLE) {
+		if (len < WAV_FMT_EXT_SIZE || memcmp(fmt + 26, g_subformat_tail, sizeof(g_subformat_tail)) != 0)
+			return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+		if (_wav_le16(fmt + 18))
+			info->valid_bits = _wav_le16(fmt + 18);
+		info->channel_mask = _wav_le32(fmt + 20);
+		format = _wav_le16(fmt + 24);
+	}
+	info->format = format;
+
+	if (format != MM_SOUND_WAV_FORMAT_PCM && format != MM_SOUND_WAV_FORMAT_FLOAT)
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+	if (format == MM_SOUND_WAV_FORMAT_FLOAT && info->bits != 32)
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+	if (info->bits != 8 && info->bits != 16 && info->bits != 24 && info->bits != 32)
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+	if (info->valid_bits > info->bits || info->channels == 0 || info->channels > MM_SOUND_WAV_MAX_CHANNELS ||
+		info->samplerate == 0 || info->samplerate > MM_SOUND_WAV_MAX_SAMPLERATE ||
+		info->block_align != info->channels * (info->bits / 8))
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+
+	return MM_ERROR_NONE;
+}
+
+/* First forward loop of a smpl chunk, its end frame is inclusive */
+static void _wav_parse_smpl(const unsigned char *smpl, uint32_t len, mm_sound_wav_info_t *info)
+{
+	const unsigned char *loop;
+	uint32_t loops, i;
+
+	loops = _wav_le32(smpl + 28);
+	if (loops > (len - WAV_SMPL_SIZE) / WAV_SMPL_LOOP_SIZE)
+		loops = (len - WAV_SMPL_SIZE) / WAV_SMPL_LOOP_SIZE;
+
+	for (i = 0; i < loops; i++) {
+		loop = smpl + WAV_SMPL_SIZE + i * WAV_SMPL_LOOP_SIZE;
+		if (_wav_le32(loop + 4) != WAV_SMPL_LOOP_FORWARD || _wav_le32(loop + 12) == UINT32_MAX)
+			continue;
+		info->loop_start = _wav_le32(loop + 8);
+		info->loop_end = _wav_le32(loop + 12) + 1;
+		return;
+	}
+}
+
+/*
+ * The RIFF size is not trusted, writers often leave it wrong : chunks are
+ * walked up to the image size. A data chunk running past the image is cut to
+ * the frames present, any other chunk doing so ends the walk. A loop outside
+ * the frames present is dropped.
+ */
+EXPORT_API
+int mm_sound_wav_index(const void *image, unsigned int size, mm_sound_wav_info_t *info)
+{
+	const unsigned char *data = (const unsigned char *)image;
+	uint64_t pos = 12, body;
+	uint32_t id, len, avail;
+	int has_fmt = 0;
+	int has_data = 0;
+	uint32_t frames;
+	int ret;
+
+	if (image == NULL || info == NULL)
+		return MM_ERROR_INVALID_ARGUMENT;
+	memset(info, 0, sizeof(mm_sound_wav_info_t));
+
+	if (size < 12 || _wav_le32(data) != WAV_RIFF_ID || _wav_le32(data + 8) != WAV_WAVE_ID)
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+
+	while (pos + 8 <= size) {
+		id = _wav_le32(data + pos);
+		len = _wav_le32(data + pos + 4);
+		body = pos + 8;
+
+		if (id == WAV_FMT_ID && !has_data) {
+			if (len < WAV_FMT_SIZE || body + (len < WAV_FMT_EXT_SIZE ? len : WAV_FMT_EXT_SIZE) > size)
+				return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+			ret = _wav_parse_fmt(data + body, len, info);
+			if (ret != MM_ERROR_NONE)
+				return ret;
+			has_fmt = 1;
+		} else if (id == WAV_DATA_ID && !has_data) {
+			if (!has_fmt)
+				return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+			avail = size - (uint32_t)body;
+			info->data_offset = (uint32_t)body;
+			info->data_declared = len;
+			info->data_size = (len < avail) ? len : avail;
+			info->data_size -= info->data_size % info->block_align;
+			has_data = 1;
+		} else if (id == WAV_SMPL_ID && len >= WAV_SMPL_SIZE && len <= size - body) {
+			_wav_parse_smpl(data + body, len, info);
+		}
+
+		if (len > size - body)
+			break;
+		pos = body + len + (len & 1);
+	}
+
+	if (!has_data)
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+
+	frames = info->data_size / info->block_align;
+	if (info->loop_end > frames || info->loop_start >= info->loop_end) {
+		info->loop_start = 0;
+		info->loop_end = 0;
+	}
+
+	return MM_ERROR_NONE;
+}
+
+/* 8 or 16 bits integer PCM, which the device plays as it is */
+EXPORT_API
+int mm_sound_wav_is_native(const mm_sound_wav_info_t *info)
+{
+	return info->format == MM_SOUND_WAV_FORMAT_PCM && (info->bits == 8 || info->bits == 16);
+}
+
+/* Converts 'frames' frames of 'src' to 16 bits, returns the bytes written to 'dst' */
+EXPORT_API
+unsigned int mm_sound_wav_to_s16(const mm_sound_wav_info_t *info, const void *src, unsigned int frames, int16_t *dst)
+{
+	const unsigned char *in = (const unsigned char *)src;
+	unsigned int samples = frames * info->channels;
+	unsigned int i;
+	union {
+		uint32_t u;
+		float f;
+	} sample;
+	float value;
+
+	switch (info->bits) {
+	case 8:
+		for (i = 0; i < samples; i++)
+			dst[i] = (int16_t)((in[i] - 128) * 256);
+		break;
+	case 16:
+		for (i = 0; i < samples; i++)
+			dst[i] = (int16_t)_wav_le16(in + i * 2);
+		break;
+	case 24:
+		for (i = 0; i < samples; i++)
+			dst[i] = (int16_t)_wav_le16(in + i * 3 + 1);
+		break;
+	case 32:
+		if (info->format == MM_SOUND_WAV_FORMAT_FLOAT) {
+			for (i = 0; i < samples; i++) {
+				sample.u = _wav_le32(in + i * 4);
+				value = sample.f * 32768.0f;
+				if (!(value > -32768.0f))		/* NaN too */
+					value = -32768.0f;
+				else if (value > 32767.0f)
+					value = 32767.0f;
+				dst[i] = (int16_t)value;
+			}
+		} else {
+			for (i = 0; i < samples; i++)
+				dst[i] = (int16_t)_wav_le16(in + i * 4 + 2);
+		}
+		break;
+	default:
+		return 0;
+	}
+
+	return samples * sizeof(int16_t);
+}
@@ -28,11 +28,290 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <errno.h>
 
 #include "mm_types.h"
 #include "mm_debug.h"
 #include "mm_error.h"
 #include "mm_source.h"
+#include "mm_sound_bank.h"
+#include "mm_sound_pool.h"
+#include "mm_sound_wav.h"
+
+/* Files played through mm_source_stream_advance() are paged in and out by windows */
+#define MM_SOURCE_STREAM_WINDOW		(256 * 1024)
+
+/* Sources of the plays in progress, more than this many come from malloc() */
+#define MM_SOURCE_POOL_COUNT		32
+
+/*
+ * One read only mapping per file, keyed by its identity. Every source opened
+ * on the same file shares it and the last close unmaps it, so repeated and
+ * concurrent plays neither map the file again nor duplicate page tables.
+ */
+typedef struct _mm_source_map {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	void *base;
+	unsigned int refcount;
+	unsigned int pins;			/* mm_source_pin() calls, locked while not 0 */
+	int wav_indexed;			/* wav holds the index of the image at wav_offset */
+	unsigned int wav_offset;
+	mm_sound_wav_info_t wav;
+	struct _mm_source_map *next;
+} mm_source_map_t;
+
+static mm_source_map_t *g_source_maps = NULL;
+static mm_source_map_stats_t g_source_map_stats = {0, };
+static pthread_mutex_t g_source_map_lock = PTHREAD_MUTEX_INITIALIZER;
+static mm_sound_pool_t g_source_pool = MM_SOUND_POOL_INITIALIZER("source", sizeof(MMSourceType), MM_SOURCE_POOL_COUNT);
+
+static mm_source_map_t *_mm_source_map_get(int fd, const struct stat *finfo)
+{
+	mm_source_map_t *map = NULL;
+
+	pthread_mutex_lock(&g_source_map_lock);
+
+	for (map = g_source_maps; map; map = map->next) {
+		if (map->dev == finfo->st_dev && map->ino == finfo->st_ino &&
+			map->size == finfo->st_size && map->mtime == finfo->st_mtime)
+			break;
+	}
+
+	if (map) {
+		map->refcount++;
+		g_source_map_stats.hits++;
+	} else {
+		map = (mm_source_map_t *)calloc(1, sizeof(mm_source_map_t));
+		if (map == NULL) {
+			debug_error("memory alloc fail\n");
+			goto out;
+		}
+		map->base = mmap(0, finfo->st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (map->base == MAP_FAILED) {
+			debug_error("MMAP fail\n");
+			free(map);
+			map = NULL;
+			goto out;
+		}
+		map->dev = finfo->st_dev;
+		map->ino = finfo->st_ino;
+		map->size = finfo->st_size;
+		map->mtime = finfo->st_mtime;
+		map->refcount = 1;
+		map->next = g_source_maps;
+		g_source_maps = map;
+
+		g_source_map_stats.files++;
+		g_source_map_stats.mapped_bytes += finfo->st_size;
+		g_source_map_stats.misses++;
+	}
+	g_source_map_stats.refs++;
+
+	debug_msg("map %p refcount %u (%u files, %llu bytes mapped)\n", map->base, map->refcount,
+			g_source_map_stats.files, g_source_map_stats.mapped_bytes);
+out:
+	pthread_mutex_unlock(&g_source_map_lock);
+	return map;
+}
+
+static void _mm_source_map_put(mm_source_map_t *map)
+{
+	mm_source_map_t **pos;
+
+	pthread_mutex_lock(&g_source_map_lock);
+
+	g_source_map_stats.refs--;
+	if (--map->refcount == 0) {
+		for (pos = &g_source_maps; *pos; pos = &(*pos)->next) {
+			if (*pos == map) {
+				*pos = map->next;
+				break;
+			}
+		}
+		if (munmap(map->base, map->size) == -1) {
+			debug_error("MEM UNMAP fail\n\n");
+		}
+		g_source_map_stats.files--;
+		g_source_map_stats.mapped_bytes -= map->size;
+		if (map->pins)
+			g_source_map_stats.pinned_bytes -= map->size;
+		free(map);
+	}
+
+	pthread_mutex_unlock(&g_source_map_lock);
+}
+
+/*
+ * Called by players as the cursor moves through a file source. Crossing into
+ * a new window reads the next two windows ahead and drops the pages of the
+ * windows left behind, so a long file keeps a bounded resident set however
+ * big it is. Pages of a mapping shared with other sources or pinned are
+ * left alone. Short files and memory sources are not touched.
+ */
+EXPORT_API
+int mm_source_stream_advance(MMSourceType *source, const void *cursor)
+{
+	mm_source_map_t *map;
+	unsigned int window, last;
+	off_t off, begin, end;
+
+	/* Bank sounds are short and their pages are shared with the other sounds */
+	if (source && source->type == MM_SOURCE_BANK)
+		return MM_ERROR_NONE;
+	if (source == NULL || source->type != MM_SOURCE_FILE || source->map == NULL)
+		return MM_ERROR_INVALID_ARGUMENT;
+	map = (mm_source_map_t *)source->map;
+
+	off = (const char *)cursor - (const char *)map->base;
+	if (off < 0 || off > map->size)
+		return MM_ERROR_INVALID_ARGUMENT;
+	if (map->size <= 2 * MM_SOURCE_STREAM_WINDOW)
+		return MM_ERROR_NONE;
+
+	window = off / MM_SOURCE_STREAM_WINDOW;
+	if (source->stream_pos == window + 1)
+		return MM_ERROR_NONE;
+
+	if (source->stream_pos == 0)
+		madvise(map->base, map->size, MADV_SEQUENTIAL);
+
+	begin = (off_t)window * MM_SOURCE_STREAM_WINDOW;
+	end = begin + 2 * MM_SOURCE_STREAM_WINDOW;
+	if (end > map->size)
+		end = map->size;
+	madvise((char *)map->base + begin, end - begin, MADV_WILLNEED);
+
+	/*
+	 * Windows behind the cursor, or the tail when a repeat went back to the
+	 * start. The lock keeps a pin or a new sharer from coming in between the
+	 * check and the drop.
+	 */
+	pthread_mutex_lock(&g_source_map_lock);
+	if (source->stream_pos && map->refcount == 1 && map->pins == 0) {
+		last = source->stream_pos - 1;
+		if (window > last) {
+			begin = (off_t)last * MM_SOURCE_STREAM_WINDOW;
+			end = (off_t)window * MM_SOURCE_STREAM_WINDOW;
+		} else {
+			begin = (off_t)last * MM_SOURCE_STREAM_WINDOW;
+			end = map->size;
+		}
+		if (madvise((char *)map->base + begin, end - begin, MADV_DONTNEED) == -1)
+			debug_warning("madvise DONTNEED fail (errno %d)\n", errno);
+	}
+	pthread_mutex_unlock(&g_source_map_lock);
+	source->stream_pos = window + 1;
+
+	return MM_ERROR_NONE;
+}
+
+/*
+ * Keep the pages of a file source resident : mlock() faults the whole mapping
+ * in and keeps it there, so the first write of a pinned sound never waits on
+ * the disk. Without the privilege the pages are only prefaulted. Pinning a
+ * bank source pins the whole bank.
+ */
+EXPORT_API
+int mm_source_pin(MMSourceType *source)
+{
+	mm_source_map_t *map;
+	volatile const char *page;
+	long page_size;
+	off_t off;
+
+	if (source == NULL || (source->type != MM_SOURCE_FILE && source->type != MM_SOURCE_BANK) || source->map == NULL)
+		return MM_ERROR_INVALID_ARGUMENT;
+	map = (mm_source_map_t *)source->map;
+
+	pthread_mutex_lock(&g_source_map_lock);
+	if (map->pins++ == 0) {
+		if (mlock(map->base, map->size) == -1) {
+			debug_warning("mlock fail (errno %d), prefault %ld bytes only\n", errno, (long)map->size);
+			madvise(map->base, map->size, MADV_WILLNEED);
+			page_size = sysconf(_SC_PAGESIZE);
+			for (off = 0; off < map->size; off += page_size) {
+				page = (const char *)map->base + off;
+				(void)*page;
+			}
+		}
+		g_source_map_stats.pinned_bytes += map->size;
+	}
+	pthread_mutex_unlock(&g_source_map_lock);
+
+	return MM_ERROR_NONE;
+}
+
+EXPORT_API
+int mm_source_unpin(MMSourceType *source)
+{
+	mm_source_map_t *map;
+
+	if (source == NULL || (source->type != MM_SOURCE_FILE && source->type != MM_SOURCE_BANK) || source->map == NULL)
+		return MM_ERROR_INVALID_ARGUMENT;
+	map = (mm_source_map_t *)source->map;
+
+	pthread_mutex_lock(&g_source_map_lock);
+	if (map->pins && --map->pins == 0) {
+		munlock(map->base, map->size);
+		g_source_map_stats.pinned_bytes -= map->size;
+	}
+	pthread_mutex_unlock(&g_source_map_lock);
+
+	return MM_ERROR_NONE;
+}
+
+/*
+ * WAV index of a source. The index of a file source is kept with its mapping,
+ * so playing the same file again does not walk its chunks again.
+ */
+EXPORT_API
+int mm_source_get_wav_info(MMSourceType *source, mm_sound_wav_info_t *info)
+{
+	mm_source_map_t *map;
+	int ret;
+
+	if (source == NULL || info == NULL || source->ptr == NULL)
+		return MM_ERROR_INVALID_ARGUMENT;
+
+	if (source->type != MM_SOURCE_FILE || source->map == NULL)
+		return mm_sound_wav_index(source->ptr, source->cur_size, info);
+	map = (mm_source_map_t *)source->map;
+
+	pthread_mutex_lock(&g_source_map_lock);
+	if (map->wav_indexed && map->wav_offset == source->medOffset) {
+		memcpy(info, &map->wav, sizeof(mm_sound_wav_info_t));
+		pthread_mutex_unlock(&g_source_map_lock);
+		return MM_ERROR_NONE;
+	}
+	pthread_mutex_unlock(&g_source_map_lock);
+
+	ret = mm_sound_wav_index(source->ptr, source->cur_size, info);
+	if (ret == MM_ERROR_NONE) {
+		pthread_mutex_lock(&g_source_map_lock);
+		memcpy(&map->wav, info, sizeof(mm_sound_wav_info_t));
+		map->wav_offset = source->medOffset;
+		map->wav_indexed = 1;
+		pthread_mutex_unlock(&g_source_map_lock);
+	}
+	return ret;
+}
+
+EXPORT_API
+int mm_source_get_map_stats(mm_source_map_stats_t *stats)
+{
+	if (stats == NULL)
+		return MM_ERROR_INVALID_ARGUMENT;
+
+	pthread_mutex_lock(&g_source_map_lock);
+	memcpy(stats, &g_source_map_stats, sizeof(mm_source_map_stats_t));
+	pthread_mutex_unlock(&g_source_map_lock);
+
+	return MM_ERROR_NONE;
+}
 
 
 bool _is_drm_file(
@@ -59,7 +338,7 @@ int mm_source_open_file(const char *filename, MMSourceType *source, int drmsuppo
 {
 	struct stat finfo = {0, };
 	int fd = -1;
-	void *mmap_buf = NULL;
+	mm_source_map_t *map = NULL;
 
 	if(filename == NULL)
 	{
@@ -181,22 +460,128 @@ int mm_source_open_file(const char *filename, MMSourceType *source, int drmsuppo
 		}
 	}
 
-	mmap_buf  = mmap(0, finfo.st_size, PROT_READ, MAP_SHARED, fd,0);
-	
-	if (mmap_buf == NULL)
+	map = _mm_source_map_get(fd, &finfo);
+	/* The mapping does not need the descriptor any more */
+	close(fd);
+	if (map == NULL)
 	{
-		debug_error("MMAP fail\n");
-		close(fd);
 		return MM_ERROR_SOUND_INTERNAL;
 	}
-	source->ptr = mmap_buf+offSet;
+	source->ptr = map->base + offSet;
 	source->medOffset = offSet;
 	debug_msg("source ptr = %p\n", source->ptr);
 	debug_msg("Med Offset Size : %d",source->medOffset);
 	source->tot_size = finfo.st_size;
 	source->cur_size = mediaSize;
 	source->type = MM_SOURCE_FILE;
-	source->fd = fd;
+	source->fd = -1;
+	source->map = map;
+	source->stream_pos = 0;
+
+	return MM_ERROR_NONE;
+}
+
+static const mm_sound_bank_entry_t *_mm_source_bank_find(const char *base, off_t size, const char *name)
+{
+	const mm_sound_bank_header_t *header = (const mm_sound_bank_header_t *)base;
+	const mm_sound_bank_entry_t *index;
+	const char *entry_name;
+	uint32_t hash = mm_sound_bank_hash(name);
+	uint32_t low = 0, high, mid;
+	off_t length = strlen(name);
+
+	if (size < (off_t)sizeof(mm_sound_bank_header_t) ||
+		header->magic != MM_SOUND_BANK_MAGIC || header->version != MM_SOUND_BANK_VERSION ||
+		header->file_size != (uint64_t)size || header->index_offset % sizeof(uint32_t) ||
+		header->index_offset > size ||
+		header->count > (size - header->index_offset) / sizeof(mm_sound_bank_entry_t)) {
+		debug_error("not a valid sound bank\n");
+		return NULL;
+	}
+	index = (const mm_sound_bank_entry_t *)(base + header->index_offset);
+
+	/* First entry of the hash, then the names sharing it */
+	high = header->count;
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (index[mid].hash < hash)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (; low < header->count && index[low].hash == hash; low++) {
+		if (index[low].name_offset > size - length - 1)
+			continue;
+		entry_name = base + index[low].name_offset;
+		if (memcmp(entry_name, name, length + 1) != 0)
+			continue;
+		if (index[low].size < MM_SOUND_BANK_WAV_HEADER || index[low].offset > size ||
+			index[low].size > size - index[low].offset) {
+			debug_error("entry of [%s] is out of the bank\n", name);
+			return NULL;
+		}
+		return &index[low];
+	}
+
+	return NULL;
+}
+
+/*
+ * Open the sound called 'name' in a bank made by mm_sound_bankgen. The source
+ * points to the WAV image of the sound inside the bank mapping, which every
+ * sound of the bank shares : a bank is mapped once however many sounds play.
+ */
+EXPORT_API
+int mm_source_open_bank(const char *bankfile, const char *name, MMSourceType *source)
+{
+	struct stat finfo = {0, };
+	const mm_sound_bank_entry_t *entry;
+	mm_source_map_t *map;
+	int fd;
+
+	if (bankfile == NULL || name == NULL || source == NULL) {
+		debug_error("invalid argument\n");
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+	if (name[0] == '\0' || strlen(name) >= MM_SOUND_BANK_NAME_MAX) {
+		debug_error("invalid sound name\n");
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+
+	fd = open(bankfile, O_RDONLY);
+	if (fd == -1) {
+		debug_error("bank [%s] open fail (errno %d)\n", bankfile, errno);
+		return MM_ERROR_SOUND_FILE_NOT_FOUND;
+	}
+	if (fstat(fd, &finfo) == -1 || finfo.st_size == 0) {
+		debug_error("bank [%s] get info fail\n", bankfile);
+		close(fd);
+		return MM_ERROR_SOUND_INVALID_FILE;
+	}
+
+	map = _mm_source_map_get(fd, &finfo);
+	close(fd);
+	if (map == NULL)
+		return MM_ERROR_SOUND_INTERNAL;
+
+	entry = _mm_source_bank_find((const char *)map->base, map->size, name);
+	if (entry == NULL) {
+		debug_error("[%s] is not in bank [%s]\n", name, bankfile);
+		_mm_source_map_put(map);
+		return MM_ERROR_SOUND_FILE_NOT_FOUND;
+	}
+
+	source->ptr = (char *)map->base + entry->offset;
+	source->medOffset = entry->offset;
+	source->tot_size = entry->size;
+	source->cur_size = entry->size;
+	source->type = MM_SOURCE_BANK;
+	source->fd = -1;
+	source->map = map;
+	source->stream_pos = 0;
+
+	debug_msg("[%s] of bank [%s] : offset %u size %u\n", name, bankfile, entry->offset, entry->size);
 
 	return MM_ERROR_NONE;
 }
@@ -273,15 +658,12 @@ int mm_source_close(MMSourceType *source)
     switch(source->type)
     {
         case MM_SOURCE_FILE:
-        	if(source->ptr != NULL)
+        case MM_SOURCE_BANK:
+        	if(source->map != NULL)
         	{
-        		source->ptr -= source->medOffset;
 				debug_msg("Med Offset Size : %d/%d",source->medOffset,source->tot_size);
-        		if (munmap(source->ptr, source->tot_size) == -1) {
-        			debug_error("MEM UNMAP fail\n\n");
-        		}
+        		_mm_source_map_put((mm_source_map_t *)source->map);
         	}
-            close(source->fd);
             break;
         case MM_SOURCE_MEMORY:
         	if(source->ptr != NULL)
@@ -297,3 +679,19 @@ int mm_source_close(MMSourceType *source)
     return MM_ERROR_NONE;
 }
 
+/* Source of a play, given back with mm_source_free() once closed */
+EXPORT_API
+MMSourceType *mm_source_alloc(void)
+{
+	MMSourceType *source = (MMSourceType *)mm_sound_pool_alloc(&g_source_pool, sizeof(MMSourceType));
+
+	if (source)
+		memset(source, 0, sizeof(MMSourceType));
+	return source;
+}
+
+EXPORT_API
+void mm_source_free(MMSourceType *source)
+{
+	mm_sound_pool_free(&g_source_pool, source);
+}
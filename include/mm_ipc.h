@@ -26,6 +26,8 @@
 #include <unistd.h>
 
 #include "mm_sound.h"
+#include "mm_sound_private.h"
+#include "mm_sound_bank.h"
 
 #define FILE_PATH 512
 
@@ -52,6 +54,8 @@ typedef struct
 	int memsize;
 	int sharedkey;
 	char filename[FILE_PATH];
+	char bank_name[MM_SOUND_BANK_NAME_MAX];	/* filename is a sound bank when set */
+	int segment_count;	/* segments follow in a mm_ipc_data_msg_t */
 
 	/* Device */
 	int route;
@@ -78,6 +82,27 @@ typedef struct
 	mmsound_ipc_t sound_msg;
 } mm_ipc_msg_t;
 
+/*
+ * Payload too large for mmsound_ipc_t, sent on the data queue with msg_type
+ * set to the client instance and only the bytes it uses. A tone sequence
+ * request comes after its segments, a keytone stats response after the stats.
+ */
+typedef struct
+{
+	long msg_type;
+	union {
+		MMSoundToneSegment_t segments[MM_SOUND_TONE_SEQUENCE_MAX];
+		mm_sound_keytone_stats_t keytone_stats;
+	} data;
+} mm_ipc_data_msg_t;
+
+/* Shared memory entry of a preload pack request : the file name in, its status out */
+typedef struct
+{
+	char filename[FILE_PATH];
+	mm_sound_preload_status_t status;
+} mm_ipc_preload_entry_t;
+
 typedef void (*mm_ipc_callback_t)(int code, int size);
 
 int MMSoundGetTime(char *position);
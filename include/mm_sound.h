@@ -1545,6 +1545,59 @@ else
  */
 int mm_sound_play_tone (MMSoundTone_t num, const volume_type_t vol_type, const double volume, const int duration, int *handle);
 
+#define MM_SOUND_TONE_SEQUENCE_MAX	16	/**< Maximum number of segments of a tone sequence */
+
+/**
+ * Segment of a tone sequence.
+ * Up to three frequencies are mixed for 'duration' milliseconds, 0 Hz means the partial is not used
+ * and a segment without any frequency is silence. When 'loop_count' is not 0, playback jumps back
+ * to segment 'loop_index' after this one, 'loop_count' times, like the predefined tones.
+ */
+typedef struct {
+	int low_frequency;		/**< Low frequency in Hz */
+	int middle_frequency;	/**< Middle frequency in Hz */
+	int high_frequency;		/**< High frequency in Hz */
+	int duration;			/**< millisecond (-1 for continuous) */
+	int loop_count;			/**< Number of jumps back to loop_index (0 for no loop) */
+	int loop_index;			/**< Segment to jump back to, must not be after this segment */
+} MMSoundToneSegment_t;
+
+/**
+ * This function is to play a user defined tone sequence.
+ *
+ * @param	segments	[in] tone segments
+ * 			count		[in] number of segments (1 ~ MM_SOUND_TONE_SEQUENCE_MAX)
+ * 			vol_type	[in] volume type
+ *			volume		[in] volume ratio (0.0 ~1.0)
+ * 			duration	[in] millisecond (-1 for infinite)
+ *			handle		[out] Handle of mm_sound_play_tone_sequence
+ *
+ * @return	This function returns MM_ERROR_NONE on success, or negative value
+ *			with error code.
+ *
+ * @remark	The sequence restarts from the first segment after the last one until duration expires.
+ *			It can be stopped with mm_sound_stop_sound().
+ * @see	mm_sound_play_tone MMSoundToneSegment_t
+ * @pre		None.
+ * @post	TONE sound will be played.
+ * @par Example
+ * @code
+int ret = 0;
+int handle = 0;
+MMSoundToneSegment_t tick[] = {
+	{ 1000, 0, 0, 30, 0, 0 },	// 1000Hz 30ms ON
+	{ 0, 0, 0, 470, 0, 0 },		// 470ms OFF
+};
+
+ret = mm_sound_play_tone_sequence(tick, 2, VOLUME_TYPE_SYSTEM, 1.0, 5000, &handle); //120 bpm metronome for 5 seconds
+if(ret < 0)
+{
+	printf("play tone sequence failed\n");
+}
+ * @endcode
+ */
+int mm_sound_play_tone_sequence (const MMSoundToneSegment_t *segments, int count, const volume_type_t vol_type, const double volume, const int duration, int *handle);
+
 /*
  * Enumerations of System audio route policy
  */
@@ -0,0 +1,82 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __MM_SOUND_BANK_H__
+#define __MM_SOUND_BANK_H__
+
+#include <stdint.h>
+
+/*
+ * Sound bank, written by mm_sound_bankgen and mapped by mm_source_open_bank().
+ *
+ * header | index[count] | names | sounds
+ *
+ * The index is sorted by name hash, so a sound is found by a binary search
+ * and a name compare without touching the other sounds. Every sound is a
+ * canonical 44 bytes WAV header followed by its PCM, already converted to
+ * the device rate, with the PCM starting on a MM_SOUND_BANK_ALIGN boundary :
+ * players parse it as the WAV file it was made from. Names are NUL
+ * terminated. Every field and the PCM are little endian; the bank is used
+ * in place through these structs, so a big endian host sees a wrong magic
+ * and refuses it.
+ */
+
+#define MM_SOUND_BANK_MAGIC		0x42534d4d	/* "MMSB" */
+#define MM_SOUND_BANK_VERSION	1
+#define MM_SOUND_BANK_ALIGN		64
+#define MM_SOUND_BANK_NAME_MAX	64			/* with the terminator */
+#define MM_SOUND_BANK_WAV_HEADER	44
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t align;				/* MM_SOUND_BANK_ALIGN */
+	uint32_t count;				/* sounds */
+	uint32_t index_offset;		/* from the beginning of the file */
+	uint32_t names_offset;
+	uint32_t data_offset;
+	uint32_t file_size;
+	uint32_t reserved;
+} mm_sound_bank_header_t;
+
+typedef struct {
+	uint32_t hash;				/* mm_sound_bank_hash() of the name */
+	uint32_t name_offset;		/* from the beginning of the file */
+	uint32_t offset;			/* of the WAV header, from the beginning of the file */
+	uint32_t size;				/* WAV header and PCM */
+	uint32_t samplerate;
+	uint16_t channels;
+	uint16_t bits;
+} mm_sound_bank_entry_t;
+
+/* FNV-1a, shared by the writer and the reader */
+static inline uint32_t mm_sound_bank_hash(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+#endif /* __MM_SOUND_BANK_H__ */
@@ -29,6 +29,10 @@
 int MMSoundClientInit(void);
 int MMSoundClientCallbackFini(void);
 int MMSoundClientPlayTone(int number, int vol_type, double volume, int time, int *handle);
+int MMSoundClientPlayToneSequence(const MMSoundToneSegment_t *segments, int count, int vol_type, double volume, int time, int *handle);
+int MMSoundClientRegisterKeytone(const char *filename, int *keytone_id);
+int MMSoundClientGetKeytoneStats(mm_sound_keytone_stats_t *stats);
+int MMSoundClientPreloadPack(const char **filenames, int count, mm_sound_preload_status_t *status);
 int MMSoundClientPlaySound(MMSoundParamType *param, int tone, int keytone, int *handle);
 int MMSoundClientStopSound(int handle);
 int _mm_sound_client_is_route_available(mm_sound_route route, bool *is_available);
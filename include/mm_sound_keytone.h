@@ -0,0 +1,51 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __MM_SOUND_KEYTONE_H__
+#define __MM_SOUND_KEYTONE_H__
+
+/* Shared between libmmfkeysound (writer) and the keytone run plugin (reader) */
+
+#define KEYTONE_PATH "/tmp/keytone"		/* Keytone pipe path */
+#define FILE_FULL_PATH 1024				/* File path lenth */
+
+#define KEYTONE_ID_NONE		-1			/* play by filename */
+#define KEYTONE_BANK_MAX	32			/* Max registered keytones */
+
+#define KEYTONE_IPC_VERSION	3			/* 1 : fixed 1028 bytes record, 2 : no timestamp */
+#define KEYTONE_FLAG_PATH	0x01		/* 'length' bytes of path follow the record */
+
+/*
+ * One press on the pipe. ID presses are the bare 16 bytes record, path presses
+ * append the path (without terminator). A whole press is written with one
+ * write() and is never bigger than PIPE_BUF, so records are not interleaved.
+ */
+typedef struct {
+	unsigned char version;				/* KEYTONE_IPC_VERSION */
+	unsigned char flags;				/* KEYTONE_FLAG_XXX */
+	unsigned short length;				/* payload size, less than FILE_FULL_PATH */
+	short keytone_id;					/* registered bank ID, or KEYTONE_ID_NONE */
+	short vol_type;
+	unsigned int sent_sec;				/* CLOCK_MONOTONIC of the client write */
+	unsigned int sent_nsec;
+} mm_sound_keytone_ipc_t;
+
+#endif /* __MM_SOUND_KEYTONE_H__ */
@@ -30,6 +30,7 @@
 #define RCV_MSG	0x21	/* rcv key */
 #define SND_MSG 0x24	/* snd key */
 #define CB_MSG   0x64		/* cb key */
+#define DATA_MSG 0x48	/* payload key, see mm_ipc_data_msg_t */
 
 #define MEMTYPE_SUPPORT_MAX (1024 * 1024) /* 1MB */
 
@@ -72,6 +73,14 @@ enum {
 	MM_SOUND_MSG_REQ_REMOVE_AVAILABLE_ROUTE_CB,
 	MM_SOUND_MSG_RES_REMOVE_AVAILABLE_ROUTE_CB,
 	MM_SOUND_MSG_INF_AVAILABLE_ROUTE_CB,
+	MM_SOUND_MSG_REQ_TONE_SEQUENCE,
+	MM_SOUND_MSG_RES_TONE_SEQUENCE,
+	MM_SOUND_MSG_REQ_KEYTONE_REGISTER,
+	MM_SOUND_MSG_RES_KEYTONE_REGISTER,
+	MM_SOUND_MSG_REQ_KEYTONE_STATS,
+	MM_SOUND_MSG_RES_KEYTONE_STATS,
+	MM_SOUND_MSG_REQ_PRELOAD_PACK,
+	MM_SOUND_MSG_RES_PRELOAD_PACK,
 };
 
 #define DSIZE sizeof(mm_ipc_msg_t)-sizeof(long)	/* data size for rcv & snd */
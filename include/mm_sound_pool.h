@@ -0,0 +1,68 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __MM_SOUND_POOL_H__
+#define __MM_SOUND_POOL_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ * Fixed block pool for the bookkeeping of a play. A pool reserves 'count'
+ * blocks of 'block_size' bytes on its first allocation and recycles them,
+ * so once warm a play of the common case never calls malloc(). Requests
+ * bigger than a block or made while every block is used fall back to
+ * malloc() and are counted, mm_sound_pool_free() tells both apart.
+ *
+ * Pools are defined statically with MM_SOUND_POOL_INITIALIZER().
+ */
+
+typedef struct {
+	unsigned int        block_size;
+	unsigned int        count;          /**< blocks of the pool */
+	unsigned int        in_use;         /**< blocks given and not freed */
+	unsigned int        peak;           /**< highest in_use */
+	unsigned long long  allocs;         /**< served by a block */
+	unsigned long long  fallbacks;      /**< served by malloc() */
+	unsigned long long  frees;          /**< blocks given back */
+} mm_sound_pool_stats_t;
+
+typedef struct _mm_sound_pool {
+	const char *name;
+	size_t block_size;
+	unsigned int count;
+	pthread_mutex_t lock;
+	char *blocks;				/* count * block_size, NULL until the first allocation */
+	void *free_list;
+	mm_sound_pool_stats_t stats;
+	struct _mm_sound_pool *next;
+} mm_sound_pool_t;
+
+#define MM_SOUND_POOL_INITIALIZER(name, block_size, count) \
+	{ name, block_size, count, PTHREAD_MUTEX_INITIALIZER, NULL, NULL, { 0, }, NULL }
+
+void *mm_sound_pool_alloc(mm_sound_pool_t *pool, size_t size);
+void mm_sound_pool_free(mm_sound_pool_t *pool, void *ptr);
+void mm_sound_pool_destroy(mm_sound_pool_t *pool);
+int mm_sound_pool_get_stats(mm_sound_pool_t *pool, mm_sound_pool_stats_t *stats);
+void mm_sound_pool_dump(void);
+
+#endif /* __MM_SOUND_POOL_H__ */
@@ -115,6 +115,7 @@ typedef struct {
 	int					handle_route;	/**< 1 for speaker, 0 for current */
 	int					volume_table;	/**< Volume Type (SW Volume table type) */
 	int					priority;		/**< 0 or 1 */
+	const char			*bank_name;		/**< sound in the bank 'filename', NULL to play 'filename' itself */
 } MMSoundParamType;
 
 
@@ -137,6 +138,25 @@ typedef struct {
 int mm_sound_play_sound_ex(MMSoundParamType *param, int *handle);
 
 
+/**
+ * This function is to play a sound of a sound bank by its name.
+ *
+ * @param	bank		[in] sound bank made by mm_sound_bankgen
+ * @param	name		[in] sound to play, the name of its WAV file without ".wav"
+ * @param	volume_type	[in] Volume type
+ * @param	callback	[in] Callback function pointer when playing is terminated
+ * @param	data		[in] Pointer to user data when callback is called
+ * @param	handle		[out] Handle of sound play.
+ *
+ * @return	This function returns MM_ERROR_NONE on success, or negative value
+ *			with error code.
+ * @remark	The sound server maps a bank once and shares it between the sounds
+ * 			played from it, instead of opening and mapping a file per sound.
+ * @see		mm_sound_play_sound mm_sound_stop_sound
+ */
+int mm_sound_play_sound_bank(const char *bank, const char *name, const volume_type_t volume_type, mm_sound_stop_callback_func callback, void *data, int *handle);
+
+
 /**
  * This function is to play key sound.
  *
@@ -153,6 +173,113 @@ int mm_sound_play_sound_ex(MMSoundParamType *param, int *handle);
 int mm_sound_play_keysound(const char *filename, const volume_type_t vol_type);
 
 
+/**
+ * This function is to register a keytone file to the keytone bank.
+ *
+ * @param	filename	[in] keytone filename to register
+ * @param	keytone_id	[out] ID to be used with mm_sound_play_keysound_id()
+ *
+ * @return	This function returns MM_ERROR_NONE on success, or negative value
+ *			with error code.
+ *
+ * @remark	The sound server keeps registered files opened, parsed and paged in,
+ * 			so a press only has to reference the ID. Registering the same file
+ * 			again returns the same ID.
+ * @see		mm_sound_play_keysound_id
+ */
+int mm_sound_keysound_register(const char *filename, int *keytone_id);
+
+
+/**
+ * Keytone latency spans, see mm_sound_get_keytone_stats()
+ */
+typedef enum {
+	MM_SOUND_KEYTONE_SPAN_PIPE,			/**< client write to server read */
+	MM_SOUND_KEYTONE_SPAN_OPEN,			/**< server read to source opened (or bank lookup) */
+	MM_SOUND_KEYTONE_SPAN_PARSE,		/**< source opened to parsed */
+	MM_SOUND_KEYTONE_SPAN_HANDLE,		/**< parsed to audio handle ready (queueing and device open) */
+	MM_SOUND_KEYTONE_SPAN_WRITE,		/**< handle ready to first period written */
+	MM_SOUND_KEYTONE_SPAN_TOTAL,		/**< client write to first period written */
+	MM_SOUND_KEYTONE_SPAN_MAX,
+} mm_sound_keytone_span_t;
+
+#define MM_SOUND_KEYTONE_HIST_BUCKETS	20	/**< bucket n counts [2^n, 2^(n+1)) usec, the last one all above */
+
+/**
+ * Keytone counters and latency histograms of the sound server
+ */
+typedef struct {
+	unsigned int presses;				/**< presses taken by the render thread */
+	unsigned int opens;					/**< audio handle opens */
+	unsigned int closes;				/**< audio handle closes after keep-alive */
+	unsigned int keepalive_ms;			/**< current keep-alive of the idle handle */
+	unsigned int interval_ms;			/**< averaged press interval */
+	unsigned int cold_count;			/**< presses which had to open the audio handle */
+	unsigned int cold_max_us;			/**< max server read to first period of cold presses */
+	unsigned long long cold_total_us;
+	unsigned int warm_count;
+	unsigned int warm_max_us;
+	unsigned long long warm_total_us;
+	unsigned int dropped;				/**< presses dropped by the flood limit or a full queue */
+	unsigned int merged;				/**< presses superseded by a later one before being played */
+	unsigned int histogram[MM_SOUND_KEYTONE_SPAN_MAX][MM_SOUND_KEYTONE_HIST_BUCKETS];
+} mm_sound_keytone_stats_t;
+
+
+/**
+ * This function is to get keytone counters and latency histograms from the sound server.
+ *
+ * @param	stats		[out] keytone statistics since the server started
+ *
+ * @return	This function returns MM_ERROR_NONE on success, or negative value
+ *			with error code.
+ *
+ * @see		mm_sound_keytone_stats_t mm_sound_keytone_span_t
+ */
+int mm_sound_get_keytone_stats(mm_sound_keytone_stats_t *stats);
+
+#define MM_SOUND_PRELOAD_PACK_MAX	1024	/**< files in one mm_sound_preload_pack() call */
+
+/**
+ * Result of one file of a preloaded pack
+ */
+typedef struct {
+	int result;							/**< MM_ERROR_NONE when the file was read through */
+	unsigned int size;					/**< bytes read */
+	unsigned int elapsed_us;			/**< pack start to the end of this file */
+} mm_sound_preload_status_t;
+
+/**
+ * This function is to have the sound server read a pack of sound files into
+ * the page cache before they are played. The files are read several at once
+ * and their WAV headers are checked.
+ *
+ * @param	filenames	[in] absolute paths of the files
+ * @param	count		[in] number of files, up to MM_SOUND_PRELOAD_PACK_MAX
+ * @param	status		[out] result of each file, 'count' entries
+ *
+ * @return	This function returns MM_ERROR_NONE when the pack was processed, the
+ *			result of each file is in 'status', or negative value with error code.
+ *
+ * @see		mm_sound_preload_status_t
+ */
+int mm_sound_preload_pack(const char **filenames, int count, mm_sound_preload_status_t *status);
+
+
+/**
+ * This function is to play a key sound registered with mm_sound_keysound_register().
+ *
+ * @param	keytone_id	[in] registered keytone ID
+ * @param	vol_type	[in] Volume type
+ *
+ * @return	This function returns MM_ERROR_NONE on success, or negative value
+ *			with error code.
+ *
+ * @see		mm_sound_keysound_register mm_sound_play_keysound
+ */
+int mm_sound_play_keysound_id(int keytone_id, const volume_type_t vol_type);
+
+
 /**
  * This function is to set sound device path.
  *
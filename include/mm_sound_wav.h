@@ -0,0 +1,62 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __MM_SOUND_WAV_H__
+#define __MM_SOUND_WAV_H__
+
+#include <stdint.h>
+
+/*
+ * Read only WAV indexer. One pass over the RIFF chunks of an image finds the
+ * format, the data chunk and the loop of a smpl chunk, every read is checked against the image size
+ * and nothing is written to it, so it runs on read only mappings and on the
+ * first block of a file. The result is a flat descriptor which can be kept
+ * instead of parsing the file again.
+ */
+
+#define MM_SOUND_WAV_FORMAT_PCM			0x0001
+#define MM_SOUND_WAV_FORMAT_FLOAT		0x0003
+#define MM_SOUND_WAV_FORMAT_EXTENSIBLE	0xFFFE
+
+#define MM_SOUND_WAV_MAX_CHANNELS		8
+#define MM_SOUND_WAV_MAX_SAMPLERATE		384000
+
+typedef struct {
+	uint16_t format;			/* PCM or FLOAT, the sub format of an EXTENSIBLE file */
+	uint16_t channels;
+	uint32_t samplerate;
+	uint16_t bits;				/* container bits of a sample : 8, 16, 24 or 32 */
+	uint16_t valid_bits;		/* significant bits, bits unless EXTENSIBLE says less */
+	uint16_t block_align;		/* bytes of a frame */
+	uint16_t reserved;
+	uint32_t channel_mask;		/* EXTENSIBLE speaker positions, 0 otherwise */
+	uint32_t data_offset;		/* PCM, from the beginning of the image */
+	uint32_t data_size;			/* whole frames present in the image */
+	uint32_t data_declared;		/* size in the data chunk header, may be more than the image holds */
+	uint32_t loop_start;		/* first frame of the smpl forward loop */
+	uint32_t loop_end;			/* frame after the loop, 0 without a loop */
+} mm_sound_wav_info_t;
+
+int mm_sound_wav_index(const void *image, unsigned int size, mm_sound_wav_info_t *info);
+int mm_sound_wav_is_native(const mm_sound_wav_info_t *info);
+unsigned int mm_sound_wav_to_s16(const mm_sound_wav_info_t *info, const void *src, unsigned int frames, int16_t *dst);
+
+#endif /* __MM_SOUND_WAV_H__ */
@@ -22,11 +22,14 @@
 #ifndef __MM_SOURCE_H__
 #define __MM_SOURCE_H__
 
+#include "mm_sound_wav.h"
+
 enum {
     MM_SOURCE_NONE = 0,
     MM_SOURCE_FILE,
     MM_SOURCE_MEMORY,
     MM_SOURCE_MEMORY_NOTALLOC,
+    MM_SOURCE_BANK,
     MM_SOURCE_NUM,
 };
 
@@ -42,8 +45,20 @@ typedef struct {
     unsigned int    tot_size;       /**< size of current memory */
     int             fd;             /**< file descriptor for file */
 	unsigned int    medOffset;		/**Media Offset */
+	void            *map;           /**< shared file mapping, MM_SOURCE_FILE and MM_SOURCE_BANK */
+	unsigned int    stream_pos;     /**< last window of mm_source_stream_advance() + 1, 0 before */
 } MMSourceType;
 
+/* File mappings shared by the sources of the same file */
+typedef struct {
+	unsigned int        files;          /**< files mapped */
+	unsigned int        refs;           /**< sources using them */
+	unsigned long long  mapped_bytes;   /**< bytes mapped */
+	unsigned int        hits;           /**< opens which found the file already mapped */
+	unsigned int        misses;         /**< opens which had to map it */
+	unsigned long long  pinned_bytes;   /**< bytes kept resident by mm_source_pin() */
+} mm_source_map_stats_t;
+
 #define MMSourceIsUnUsed(psource) \
     ((psource)->type == MM_SOUND_SOURCE_NONE)
 
@@ -63,10 +78,18 @@ typedef struct {
     ((psource)->tot_size)
 
 int mm_source_open_file(const char *filename, MMSourceType* source, int drmsupport);
+int mm_source_open_bank(const char *bankfile, const char *name, MMSourceType *source);
 int mm_source_open_full_memory(const void *ptr, int totsize, int alloc, MMSourceType *source);
 int mm_source_open_memory(const void *ptr, int totsize, int size, MMSourceType *source);
 int mm_source_append_memory(const void *ptr, int size, MMSourceType *source);
 int mm_source_close(MMSourceType *source);
+MMSourceType *mm_source_alloc(void);
+void mm_source_free(MMSourceType *source);
+int mm_source_stream_advance(MMSourceType *source, const void *cursor);
+int mm_source_pin(MMSourceType *source);
+int mm_source_unpin(MMSourceType *source);
+int mm_source_get_map_stats(mm_source_map_stats_t *stats);
+int mm_source_get_wav_info(MMSourceType *source, mm_sound_wav_info_t *info);
 
 #endif  /* __MM_SOURCE_H__ */
 
@@ -1143,6 +1143,57 @@ int mm_sound_play_sound(const char *filename, const volume_type_t volume_type, m
 }
 
 
+EXPORT_API
+int mm_sound_play_sound_bank(const char *bank, const char *name, const volume_type_t volume_type, mm_sound_stop_callback_func callback, void *data, int *handle)
+{
+	MMSoundParamType param = { 0, };
+	int err;
+	int lhandle = -1;
+
+	debug_fenter();
+
+	/* Check input param */
+	if(bank == NULL || name == NULL || name[0] == '\0') {
+		debug_error("bank or name is NULL\n");
+		return MM_ERROR_SOUND_FILE_NOT_FOUND;
+	}
+	if(strlen(name) >= MM_SOUND_BANK_NAME_MAX) {
+		debug_error("name is too long\n");
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+	if(volume_type < 0 || volume_type >= VOLUME_TYPE_MAX) {
+		debug_error("Volume type is out of range [%d]\n", volume_type);
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+
+	/* Play sound */
+	param.filename = bank;
+	param.bank_name = name;
+	param.volume = 0; /* volume value dose not effect anymore */
+	param.callback = callback;
+	param.data = data;
+	param.loop = 1;
+	param.volume_table = volume_type;
+	param.priority = AVSYS_AUDIO_PRIORITY_NORMAL;
+	param.handle_route = MM_SOUND_HANDLE_ROUTE_USING_CURRENT;
+
+	err = MMSoundClientPlaySound(&param, 0, 0, &lhandle);
+	if (err < 0) {
+		debug_error("Failed to play sound\n");
+		return err;
+	}
+
+	/* Set handle to return */
+	if (handle) {
+		*handle = lhandle;
+	} else {
+		debug_critical("The sound handle cannot be get [%d]\n", lhandle);
+	}
+
+	debug_fleave();
+	return MM_ERROR_NONE;
+}
+
 EXPORT_API
 int mm_sound_play_sound_ex(MMSoundParamType *param, int *handle)
 {
@@ -1241,6 +1292,152 @@ int mm_sound_play_tone (MMSoundTone_t num, const volume_type_t vol_type, const d
 	return MM_ERROR_NONE;
 }
 
+EXPORT_API
+int mm_sound_play_tone_sequence (const MMSoundToneSegment_t *segments, int count, const volume_type_t vol_type, const double volume, const int duration, int *handle)
+{
+	int lhandle = -1;
+	int err = MM_ERROR_NONE;
+	int i;
+
+	debug_fenter();
+
+	/* Check input param */
+	if(segments == NULL || count < 1 || count > MM_SOUND_TONE_SEQUENCE_MAX) {
+		debug_error("Segments are invalid %p, %d\n", segments, count);
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+	for(i = 0; i < count; i++) {
+		if(segments[i].low_frequency < 0 || segments[i].middle_frequency < 0 || segments[i].high_frequency < 0) {
+			debug_error("Frequency of segment %d is invalid\n", i);
+			return MM_ERROR_INVALID_ARGUMENT;
+		}
+		if(segments[i].duration < -1) {
+			debug_error("Duration of segment %d is invalid %d\n", i, segments[i].duration);
+			return MM_ERROR_INVALID_ARGUMENT;
+		}
+		if(segments[i].loop_count < 0 || segments[i].loop_index < 0 || segments[i].loop_index > i) {
+			debug_error("Loop of segment %d is invalid %d, %d\n", i, segments[i].loop_count, segments[i].loop_index);
+			return MM_ERROR_INVALID_ARGUMENT;
+		}
+	}
+	if(duration < -1) {
+		debug_error("number is invalid %d\n", duration);
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+	if(vol_type < VOLUME_TYPE_SYSTEM || vol_type >= VOLUME_TYPE_MAX) {
+		debug_error("Volume Type is invalid %d\n", vol_type);
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+	if(volume < 0.0 || volume > 1.0) {
+		debug_error("Volume Value is invalid %d\n", vol_type);
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+
+	/* Play tone sequence */
+	debug_msg("Call MMSoundClientPlayToneSequence\n");
+	err = MMSoundClientPlayToneSequence (segments, count, vol_type, volume, duration, &lhandle);
+	if (err < 0) {
+		debug_error("Failed to play tone sequence\n");
+		return err;
+	}
+
+	/* Set handle to return */
+	if (handle)
+		*handle = lhandle;
+	else
+		debug_critical("The sound handle cannot be get [%d]\n", lhandle);
+
+	debug_fleave();
+	return MM_ERROR_NONE;
+}
+
+EXPORT_API
+int mm_sound_keysound_register(const char *filename, int *keytone_id)
+{
+	int err = MM_ERROR_NONE;
+	int id = -1;
+
+	debug_fenter();
+
+	if (filename == NULL || keytone_id == NULL) {
+		debug_error("Invalid parameter %p, %p\n", filename, keytone_id);
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+	if (strlen(filename) >= FILE_PATH) {
+		debug_error("File name is too long\n");
+		return MM_ERROR_SOUND_INVALID_PATH;
+	}
+	if (access(filename, R_OK) == -1) {
+		debug_error("File not exists [%s][%d]\n", filename, errno);
+		return (errno == ENOENT) ? MM_ERROR_SOUND_FILE_NOT_FOUND : MM_ERROR_SOUND_INTERNAL;
+	}
+
+	err = MMSoundClientRegisterKeytone(filename, &id);
+	if (err < 0) {
+		debug_error("Failed to register keytone\n");
+		return err;
+	}
+	*keytone_id = id;
+
+	debug_fleave();
+	return MM_ERROR_NONE;
+}
+
+EXPORT_API
+int mm_sound_get_keytone_stats(mm_sound_keytone_stats_t *stats)
+{
+	int err = MM_ERROR_NONE;
+
+	debug_fenter();
+
+	if (stats == NULL) {
+		debug_error("stats is null\n");
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+
+	err = MMSoundClientGetKeytoneStats(stats);
+	if (err < 0) {
+		debug_error("Failed to get keytone stats\n");
+		return err;
+	}
+
+	debug_fleave();
+	return MM_ERROR_NONE;
+}
+
+EXPORT_API
+int mm_sound_preload_pack(const char **filenames, int count, mm_sound_preload_status_t *status)
+{
+	int err = MM_ERROR_NONE;
+	int i;
+
+	debug_fenter();
+
+	if (filenames == NULL || status == NULL) {
+		debug_error("filenames or status is null\n");
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+	if (count <= 0 || count > MM_SOUND_PRELOAD_PACK_MAX) {
+		debug_error("Invalid count %d, max %d\n", count, MM_SOUND_PRELOAD_PACK_MAX);
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+	for (i = 0; i < count; i++) {
+		if (filenames[i] == NULL || filenames[i][0] != '/') {
+			debug_error("File %d is not an absolute path\n", i);
+			return MM_ERROR_INVALID_ARGUMENT;
+		}
+	}
+
+	err = MMSoundClientPreloadPack(filenames, count, status);
+	if (err < 0) {
+		debug_error("Failed to preload the pack\n");
+		return err;
+	}
+
+	debug_fleave();
+	return MM_ERROR_NONE;
+}
+
 ///////////////////////////////////
 ////     MMSOUND ROUTING APIs
 ///////////////////////////////////
@@ -57,6 +57,7 @@
 int g_msg_scsnd;	/* global msg queue id sound client snd */
 int g_msg_scrcv;	/* global msg queue id sound client rcv */
 int g_msg_sccb;		/* global msg queue id sound client callback */
+int g_msg_scdata;	/* global msg queue id sound client payload */
 
 /* callback */
 struct __callback_param
@@ -79,6 +80,9 @@ static int __MMIpcRecvMsg(int msgtype, mm_ipc_msg_t *msg);
 static int __MMIpcSndMsg(mm_ipc_msg_t *msg);
 static int __MMIpcCBRecvMsg(int msgtype, mm_ipc_msg_t *msg);
 static int __MMSoundGetMsg(void);
+static void __MMIpcDataPurge(int instance);
+static int __MMIpcDataSnd(int instance, mm_ipc_data_msg_t *data, int size);
+static int __MMIpcDataRecv(int instance, mm_ipc_data_msg_t *data);
 
 int MMSoundClientInit(void)
 {
@@ -442,6 +446,343 @@ cleanup:
 }
 
 
+int MMSoundClientPlayToneSequence(const MMSoundToneSegment_t *segments, int count, int vol_type, double volume, int time, int *handle)
+{
+	mm_ipc_msg_t msgrcv = {0,};
+	mm_ipc_msg_t msgsnd = {0,};
+	mm_ipc_data_msg_t data;
+
+	int ret = MM_ERROR_NONE;
+	int instance = -1; 	/* instance is unique to communicate with server : client message queue filter type */
+
+	debug_fenter();
+
+	if (__mm_sound_client_get_msg_queue() != MM_ERROR_NONE)
+		return ret;
+
+	/* read mm-session type */
+	int sessionType = MM_SESSION_TYPE_SHARE;
+	if(MM_ERROR_NONE != _mm_session_util_read_type(-1, &sessionType))
+	{
+		debug_warning("[Client] Read MMSession Type failed. use default \"share\" type\n");
+		sessionType = MM_SESSION_TYPE_SHARE;
+
+		if(MM_ERROR_NONE != mm_session_init(sessionType))
+		{
+			debug_critical("[Client] MMSessionInit() failed\n");
+			return MM_ERROR_POLICY_INTERNAL;
+		}
+	}
+
+	instance = getpid();
+	debug_msg("[Client] pid for client ::: [%d]\n", instance);
+
+	pthread_mutex_lock(&g_thread_mutex);
+
+	/* Send msg */
+	debug_msg("[Client] Input segments : %d\n", count);
+	msgsnd.sound_msg.msgtype = MM_SOUND_MSG_REQ_TONE_SEQUENCE;
+	msgsnd.sound_msg.msgid = instance;
+	msgsnd.sound_msg.session_type = sessionType;
+	msgsnd.sound_msg.volume = volume;
+	msgsnd.sound_msg.volume_table = vol_type;
+	msgsnd.sound_msg.handle = -1;
+	msgsnd.sound_msg.repeat = time;
+	msgsnd.sound_msg.segment_count = count;
+
+	/* The segments go first, the server reads them when the request comes */
+	memcpy(data.data.segments, segments, count * sizeof(MMSoundToneSegment_t));
+	ret = __MMIpcDataSnd(instance, &data, count * sizeof(MMSoundToneSegment_t));
+	if (ret != MM_ERROR_NONE)
+	{
+		debug_error("[Client] Fail to send segments\n");
+		goto cleanup;
+	}
+
+	ret = __MMIpcSndMsg(&msgsnd);
+	if (ret != MM_ERROR_NONE)
+	{
+		debug_error("[Client] Fail to send msg\n");
+		goto cleanup;
+	}
+
+	/* Receive */
+	ret = __MMIpcRecvMsg(instance, &msgrcv);
+	if (ret != MM_ERROR_NONE)
+	{
+		debug_error("[Client] Fail to recieve msg\n");
+		goto cleanup;
+	}
+
+	switch (msgrcv.sound_msg.msgtype)
+	{
+	case MM_SOUND_MSG_RES_TONE_SEQUENCE:
+		*handle = msgrcv.sound_msg.handle;
+		if(*handle == -1)
+			debug_error("[Client] The handle is not get\n");
+
+		debug_msg("[Client] Success to play tone sequence handle : [%d]\n", *handle);
+		break;
+	case MM_SOUND_MSG_RES_ERROR:
+		debug_error("[Client] Error occurred \n");
+		ret = msgrcv.sound_msg.code;
+		goto cleanup;
+		break;
+	default:
+		debug_critical("[Client] Unexpected state with communication \n");
+		ret = msgrcv.sound_msg.code;
+		goto cleanup;
+		break;
+	}
+cleanup:
+	pthread_mutex_unlock(&g_thread_mutex);
+
+	debug_fleave();
+	return ret;
+}
+
+
+int MMSoundClientRegisterKeytone(const char *filename, int *keytone_id)
+{
+	mm_ipc_msg_t msgrcv = {0,};
+	mm_ipc_msg_t msgsnd = {0,};
+
+	int ret = MM_ERROR_NONE;
+	int instance = -1; 	/* instance is unique to communicate with server : client message queue filter type */
+
+	debug_fenter();
+
+	if (__mm_sound_client_get_msg_queue() != MM_ERROR_NONE)
+		return ret;
+
+	instance = getpid();
+	debug_msg("[Client] pid for client ::: [%d]\n", instance);
+
+	pthread_mutex_lock(&g_thread_mutex);
+
+	/* Send msg */
+	msgsnd.sound_msg.msgtype = MM_SOUND_MSG_REQ_KEYTONE_REGISTER;
+	msgsnd.sound_msg.msgid = instance;
+	msgsnd.sound_msg.keytone = -1;
+	strncpy(msgsnd.sound_msg.filename, filename, sizeof(msgsnd.sound_msg.filename)-1);
+
+	ret = __MMIpcSndMsg(&msgsnd);
+	if (ret != MM_ERROR_NONE)
+	{
+		debug_error("[Client] Fail to send msg\n");
+		goto cleanup;
+	}
+
+	/* Receive */
+	ret = __MMIpcRecvMsg(instance, &msgrcv);
+	if (ret != MM_ERROR_NONE)
+	{
+		debug_error("[Client] Fail to recieve msg\n");
+		goto cleanup;
+	}
+
+	switch (msgrcv.sound_msg.msgtype)
+	{
+	case MM_SOUND_MSG_RES_KEYTONE_REGISTER:
+		*keytone_id = msgrcv.sound_msg.keytone;
+		debug_msg("[Client] Success to register keytone [%s] as [%d]\n", filename, *keytone_id);
+		break;
+	case MM_SOUND_MSG_RES_ERROR:
+		debug_error("[Client] Error occurred \n");
+		ret = msgrcv.sound_msg.code;
+		goto cleanup;
+		break;
+	default:
+		debug_critical("[Client] Unexpected state with communication \n");
+		ret = msgrcv.sound_msg.code;
+		goto cleanup;
+		break;
+	}
+cleanup:
+	pthread_mutex_unlock(&g_thread_mutex);
+
+	debug_fleave();
+	return ret;
+}
+
+int MMSoundClientGetKeytoneStats(mm_sound_keytone_stats_t *stats)
+{
+	mm_ipc_msg_t msgrcv = {0,};
+	mm_ipc_msg_t msgsnd = {0,};
+	mm_ipc_data_msg_t data;
+
+	int ret = MM_ERROR_NONE;
+	int instance = -1; 	/* instance is unique to communicate with server : client message queue filter type */
+
+	debug_fenter();
+
+	if (__mm_sound_client_get_msg_queue() != MM_ERROR_NONE)
+		return ret;
+
+	instance = getpid();
+	debug_msg("[Client] pid for client ::: [%d]\n", instance);
+
+	pthread_mutex_lock(&g_thread_mutex);
+
+	/* Send msg */
+	msgsnd.sound_msg.msgtype = MM_SOUND_MSG_REQ_KEYTONE_STATS;
+	msgsnd.sound_msg.msgid = instance;
+
+	/* Stats left by a former request which timed out */
+	__MMIpcDataPurge(instance);
+
+	ret = __MMIpcSndMsg(&msgsnd);
+	if (ret != MM_ERROR_NONE)
+	{
+		debug_error("[Client] Fail to send msg\n");
+		goto cleanup;
+	}
+
+	/* Receive */
+	ret = __MMIpcRecvMsg(instance, &msgrcv);
+	if (ret != MM_ERROR_NONE)
+	{
+		debug_error("[Client] Fail to recieve msg\n");
+		goto cleanup;
+	}
+
+	switch (msgrcv.sound_msg.msgtype)
+	{
+	case MM_SOUND_MSG_RES_KEYTONE_STATS:
+		/* The stats were sent just before the response */
+		if (__MMIpcDataRecv(instance, &data) != sizeof(mm_sound_keytone_stats_t))
+		{
+			debug_error("[Client] Keytone stats are missing\n");
+			ret = MM_ERROR_SOUND_INTERNAL;
+			goto cleanup;
+		}
+		memcpy(stats, &data.data.keytone_stats, sizeof(mm_sound_keytone_stats_t));
+		debug_msg("[Client] Success to get keytone stats, presses [%u]\n", stats->presses);
+		break;
+	case MM_SOUND_MSG_RES_ERROR:
+		debug_error("[Client] Error occurred \n");
+		ret = msgrcv.sound_msg.code;
+		goto cleanup;
+		break;
+	default:
+		debug_critical("[Client] Unexpected state with communication \n");
+		ret = msgrcv.sound_msg.code;
+		goto cleanup;
+		break;
+	}
+cleanup:
+	pthread_mutex_unlock(&g_thread_mutex);
+
+	debug_fleave();
+	return ret;
+}
+
+int MMSoundClientPreloadPack(const char **filenames, int count, mm_sound_preload_status_t *status)
+{
+	mm_ipc_msg_t msgrcv = {0,};
+	mm_ipc_msg_t msgsnd = {0,};
+	mm_ipc_preload_entry_t *entries = MAP_FAILED;
+	char shm_name[FILE_PATH];
+	size_t shm_size = count * sizeof(mm_ipc_preload_entry_t);
+	int shm_fd = -1;
+	int ret = MM_ERROR_NONE;
+	int instance = -1; 	/* instance is unique to communicate with server : client message queue filter type */
+	int i;
+
+	debug_fenter();
+
+	/* The names go through shared memory, the queue message holds one path only */
+	for (i = 0; i < count; i++) {
+		if (strlen(filenames[i]) >= FILE_PATH) {
+			debug_error("[Client] File name is too long [%s]\n", filenames[i]);
+			return MM_ERROR_INVALID_ARGUMENT;
+		}
+	}
+
+	if (__mm_sound_client_get_msg_queue() != MM_ERROR_NONE)
+		return MM_ERROR_SOUND_INTERNAL;
+
+	instance = getpid();
+	debug_msg("[Client] pid for client ::: [%d]\n", instance);
+
+	pthread_mutex_lock(&g_thread_mutex);
+
+	snprintf(shm_name, sizeof(shm_name), "%d_preload", instance);
+	shm_fd = shm_open(shm_name, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (shm_fd < 0) {
+		debug_error("[Client] Fail to create shm_open, errno %d\n", errno);
+		ret = MM_ERROR_SOUND_INTERNAL;
+		goto cleanup;
+	}
+	if (ftruncate(shm_fd, shm_size) == -1) {
+		debug_error("[Client] Fail to ftruncate\n");
+		ret = MM_ERROR_SOUND_INTERNAL;
+		goto cleanup;
+	}
+	entries = mmap(0, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	if (entries == MAP_FAILED) {
+		debug_error("[Client] MMAP failed\n");
+		ret = MM_ERROR_SOUND_INTERNAL;
+		goto cleanup;
+	}
+	for (i = 0; i < count; i++) {
+		strncpy(entries[i].filename, filenames[i], sizeof(entries[i].filename)-1);
+		entries[i].status.result = MM_ERROR_SOUND_INTERNAL;
+	}
+
+	/* Send msg */
+	msgsnd.sound_msg.msgtype = MM_SOUND_MSG_REQ_PRELOAD_PACK;
+	msgsnd.sound_msg.msgid = instance;
+	msgsnd.sound_msg.memsize = shm_size;
+	strncpy(msgsnd.sound_msg.filename, shm_name, sizeof(msgsnd.sound_msg.filename)-1);
+
+	ret = __MMIpcSndMsg(&msgsnd);
+	if (ret != MM_ERROR_NONE)
+	{
+		debug_error("[Client] Fail to send msg\n");
+		goto cleanup;
+	}
+
+	/* Receive */
+	ret = __MMIpcRecvMsg(instance, &msgrcv);
+	if (ret != MM_ERROR_NONE)
+	{
+		debug_error("[Client] Fail to recieve msg\n");
+		goto cleanup;
+	}
+
+	switch (msgrcv.sound_msg.msgtype)
+	{
+	case MM_SOUND_MSG_RES_PRELOAD_PACK:
+		/* The server wrote the status of each file next to its name */
+		for (i = 0; i < count; i++)
+			status[i] = entries[i].status;
+		debug_msg("[Client] Success to preload %d files\n", count);
+		break;
+	case MM_SOUND_MSG_RES_ERROR:
+		debug_error("[Client] Error occurred \n");
+		ret = msgrcv.sound_msg.code;
+		goto cleanup;
+		break;
+	default:
+		debug_critical("[Client] Unexpected state with communication \n");
+		ret = msgrcv.sound_msg.code;
+		goto cleanup;
+		break;
+	}
+cleanup:
+	if (entries != MAP_FAILED)
+		munmap(entries, shm_size);
+	if (shm_fd >= 0) {
+		close(shm_fd);
+		shm_unlink(shm_name);
+	}
+	pthread_mutex_unlock(&g_thread_mutex);
+
+	debug_fleave();
+	return ret;
+}
+
 int MMSoundClientPlaySound(MMSoundParamType *param, int tone, int keytone, int *handle)
 {
 	mm_ipc_msg_t msgrcv = {0,};
@@ -612,6 +953,20 @@ int MMSoundClientPlaySound(MMSoundParamType *param, int tone, int keytone, int *
 			debug_error("File name is over count\n");
 			ret = MM_ERROR_SOUND_INVALID_PATH;
 		}
+
+		if (param->bank_name)
+		{
+			if (strlen(param->bank_name) < sizeof(msgsnd.sound_msg.bank_name))
+			{
+				strncpy(msgsnd.sound_msg.bank_name, param->bank_name, sizeof(msgsnd.sound_msg.bank_name)-1);
+			}
+			else
+			{
+				debug_error("Sound name is over count\n");
+				ret = MM_ERROR_SOUND_INVALID_PATH;
+				goto cleanup;
+			}
+		}
 			
 		msgsnd.sound_msg.keytone = keytone;
 
@@ -1338,6 +1693,42 @@ static int __MMIpcSndMsg(mm_ipc_msg_t *msg)
 	return MM_ERROR_NONE;
 }
 
+/* Drops payloads of this instance the server never read or the client never received */
+static void __MMIpcDataPurge(int instance)
+{
+	mm_ipc_data_msg_t data;
+
+	while (msgrcv(g_msg_scdata, &data, sizeof(data.data), instance, IPC_NOWAIT | MSG_NOERROR) != -1)
+		debug_warning("[Client] Drop a stale data msg\n");
+}
+
+static int __MMIpcDataSnd(int instance, mm_ipc_data_msg_t *data, int size)
+{
+	__MMIpcDataPurge(instance);
+
+	data->msg_type = instance;
+	if (msgsnd(g_msg_scdata, data, size, 0) == -1)
+	{
+		debug_critical("[Client] Fail to send data msgid : [%d], errno [%d]\n", g_msg_scdata, errno);
+		return MM_ERROR_SOUND_INTERNAL;
+	}
+	return MM_ERROR_NONE;
+}
+
+/* Returns the size of the payload received, -1 when there is none */
+static int __MMIpcDataRecv(int instance, mm_ipc_data_msg_t *data)
+{
+	ssize_t size;
+
+	size = msgrcv(g_msg_scdata, data, sizeof(data->data), instance, IPC_NOWAIT);
+	if (size == -1)
+	{
+		debug_error("[Client] Fail to receive data msgid : [%d], errno [%d]\n", g_msg_scdata, errno);
+		return -1;
+	}
+	return (int)size;
+}
+
 static int __MMSoundGetMsg(void)
 {
 	/* Init message queue, generate msgid for communication to server */
@@ -1349,8 +1740,9 @@ static int __MMSoundGetMsg(void)
 	g_msg_scsnd = msgget(ftok(KEY_BASE_PATH, RCV_MSG), 0666);
 	g_msg_scrcv = msgget(ftok(KEY_BASE_PATH, SND_MSG), 0666);
 	g_msg_sccb = msgget(ftok(KEY_BASE_PATH, CB_MSG), 0666);
+	g_msg_scdata = msgget(ftok(KEY_BASE_PATH, DATA_MSG), 0666);
 
-	if ((g_msg_scsnd == -1 || g_msg_scrcv == -1 || g_msg_sccb == -1) != MM_ERROR_NONE) {
+	if ((g_msg_scsnd == -1 || g_msg_scrcv == -1 || g_msg_sccb == -1 || g_msg_scdata == -1) != MM_ERROR_NONE) {
 		if (errno == EACCES) {
 			debug_warning("Require ROOT permission.\n");
 		} else if (errno == ENOMEM) {
@@ -1365,6 +1757,7 @@ static int __MMSoundGetMsg(void)
 	debug_msg("Get msg queue id from server : [%d]\n", g_msg_scsnd);
 	debug_msg("Get msg queue id from server : [%d]\n", g_msg_scrcv);
 	debug_msg("Get msg queue id from server : [%d]\n", g_msg_sccb);
+	debug_msg("Get msg queue id from server : [%d]\n", g_msg_scdata);
 	
 	debug_fleave();
 	return MM_ERROR_NONE;
@@ -29,6 +29,9 @@
 
 #include <sys/stat.h>
 #include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
 
 #include <mm_types.h>
 #include <mm_error.h>
@@ -36,31 +39,51 @@
 #include <mm_debug.h>
 #include <mm_sound.h>
 #include <mm_sound_private.h>
+#include <mm_sound_keytone.h>
+
+#define KEYTONE_CHECK_CACHE_MAX	8		/* Number of files remembered as existing */
+#define KEYTONE_CHECK_CACHE_SEC	5		/* Check a remembered file again after this */
 
-#define KEYTONE_PATH "/tmp/keytone"		/* Keytone pipe path */
-#define FILE_FULL_PATH 1024				/* File path lenth */
 typedef struct {
-	char filename[1024];
-	int vol_type;
-}ipc_t;
+	char filename[FILE_FULL_PATH];
+	time_t checked;
+} keysound_check_t;
 
-EXPORT_API
-int mm_sound_play_keysound(const char *filename, const volume_type_t vol_type)
+/* Per process keytone channel : pipe is opened on first press and kept */
+static pthread_mutex_t g_keysound_lock = PTHREAD_MUTEX_INITIALIZER;
+static int g_keysound_fd = -1;
+static keysound_check_t g_keysound_check[KEYTONE_CHECK_CACHE_MAX];
+static int g_keysound_check_next = 0;
+
+static time_t __mm_sound_keysound_now(void)
 {
-	int err = MM_ERROR_NONE;
-	int fd = -1;
-	int size = 0;
-	ipc_t data = {{0,},};
+	struct timespec ts;
 
-	debug_fenter();
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
 
-	if(!filename)
-		return MM_ERROR_SOUND_INVALID_FILE;
+/* Must be called with g_keysound_lock */
+static int __mm_sound_keysound_check(const char *filename)
+{
+	time_t now = __mm_sound_keysound_now();
+	keysound_check_t *entry = NULL;
+	int i;
+
+	for (i = 0; i < KEYTONE_CHECK_CACHE_MAX; i++) {
+		if (strcmp(g_keysound_check[i].filename, filename) == 0) {
+			entry = &g_keysound_check[i];
+			if (now - entry->checked < KEYTONE_CHECK_CACHE_SEC)
+				return MM_ERROR_NONE;
+			break;
+		}
+	}
 
 	/* Check whether file exists */
-	fd = open(filename, O_RDONLY);
-	if(fd == -1) {
-		debug_error("file open failed with [%s][%d]\n", strerror(errno), errno);
+	if (access(filename, R_OK) == -1) {
+		debug_error("file access failed with [%s][%d]\n", strerror(errno), errno);
+		if (entry)
+			entry->filename[0] = '\0';
 		switch(errno)
 		{
 		case ENOENT:
@@ -69,32 +92,140 @@ int mm_sound_play_keysound(const char *filename, const volume_type_t vol_type)
 			return MM_ERROR_SOUND_INTERNAL;
 		}
 	}
-	close(fd);
-	fd = -1;
-
-	/* Open PIPE */
-	fd = open(KEYTONE_PATH, O_WRONLY | O_NONBLOCK);
-	if (fd == -1) {
-		debug_error("Fail to open pipe\n");
-		return MM_ERROR_SOUND_FILE_NOT_FOUND;
+
+	if (entry == NULL) {
+		entry = &g_keysound_check[g_keysound_check_next];
+		g_keysound_check_next = (g_keysound_check_next + 1) % KEYTONE_CHECK_CACHE_MAX;
+		strncpy(entry->filename, filename, FILE_FULL_PATH - 1);
 	}
-	data.vol_type = vol_type;
-	strncpy(data.filename, filename, FILE_FULL_PATH);
-	debug_msg("The file name [%s]\n", data.filename);
-	size = sizeof(ipc_t);
-
-	/* Write to PIPE */
-	err = write(fd, &data, size);
-	if(err < 0) {
-		debug_error("Fail to write data: %s\n", strerror(err));
-		close(fd);
-		return MM_ERROR_SOUND_INTERNAL;
+	entry->checked = now;
+
+	return MM_ERROR_NONE;
+}
+
+/*
+ * A write without reader raises SIGPIPE, which must not kill the application :
+ * ignore it when nobody handles it, an application handler is left alone.
+ */
+static void __mm_sound_keysound_ignore_sigpipe(void)
+{
+	struct sigaction action;
+
+	if (sigaction(SIGPIPE, NULL, &action) == -1)
+		return;
+	if (!(action.sa_flags & SA_SIGINFO) && action.sa_handler == SIG_DFL) {
+		action.sa_handler = SIG_IGN;
+		if (sigaction(SIGPIPE, &action, NULL) == -1)
+			debug_warning("Fail to ignore SIGPIPE: %s\n", strerror(errno));
 	}
-	/* Close PIPE */
-	close(fd);
+}
+
+/* Must be called with g_keysound_lock */
+static int __mm_sound_keysound_write(void *data, int size)
+{
+	mm_sound_keytone_ipc_t *record = (mm_sound_keytone_ipc_t *)data;
+	struct timespec sent;
+	int err = MM_ERROR_SOUND_INTERNAL;
+	int retry = 0;
+	ssize_t ret;
+
+	for (retry = 0; retry < 2; retry++) {
+		if (g_keysound_fd == -1) {
+			/* Open PIPE */
+			g_keysound_fd = open(KEYTONE_PATH, O_WRONLY | O_NONBLOCK);
+			if (g_keysound_fd == -1) {
+				debug_error("Fail to open pipe\n");
+				err = MM_ERROR_SOUND_FILE_NOT_FOUND;
+				break;
+			}
+			fcntl(g_keysound_fd, F_SETFD, FD_CLOEXEC);
+			__mm_sound_keysound_ignore_sigpipe();
+		}
+
+		/* Write to PIPE, stamped for the server latency trace */
+		clock_gettime(CLOCK_MONOTONIC, &sent);
+		record->sent_sec = sent.tv_sec;
+		record->sent_nsec = sent.tv_nsec;
+		ret = write(g_keysound_fd, data, size);
+		if (ret == size) {
+			err = MM_ERROR_NONE;
+			break;
+		}
+
+		debug_error("Fail to write data: %s\n", strerror(errno));
+		err = MM_ERROR_SOUND_INTERNAL;
+		if (ret == -1 && errno == EPIPE) {
+			/* Server has gone (restarted), connect to the new pipe */
+			debug_warning("keytone pipe is broken, reconnect\n");
+			close(g_keysound_fd);
+			g_keysound_fd = -1;
+			continue;
+		}
+		/* Pipe is full, drop this press */
+		break;
+	}
+
+	return err;
+}
+
+EXPORT_API
+int mm_sound_play_keysound(const char *filename, const volume_type_t vol_type)
+{
+	int err = MM_ERROR_NONE;
+	int len = 0;
+	char buf[sizeof(mm_sound_keytone_ipc_t) + FILE_FULL_PATH];
+	mm_sound_keytone_ipc_t *data = (mm_sound_keytone_ipc_t *)buf;
+
+	debug_fenter();
+
+	if(!filename)
+		return MM_ERROR_SOUND_INVALID_FILE;
+
+	len = strlen(filename);
+	if (len >= FILE_FULL_PATH)
+		return MM_ERROR_SOUND_INVALID_PATH;
+
+	/* Record and path go out with a single write */
+	memset(data, 0, sizeof(mm_sound_keytone_ipc_t));
+	data->version = KEYTONE_IPC_VERSION;
+	data->flags = KEYTONE_FLAG_PATH;
+	data->length = len;
+	data->keytone_id = KEYTONE_ID_NONE;
+	data->vol_type = vol_type;
+	memcpy(buf + sizeof(mm_sound_keytone_ipc_t), filename, len);
+	debug_msg("The file name [%s]\n", filename);
+
+	pthread_mutex_lock(&g_keysound_lock);
+	err = __mm_sound_keysound_check(filename);
+	if (err == MM_ERROR_NONE)
+		err = __mm_sound_keysound_write(buf, sizeof(mm_sound_keytone_ipc_t) + len);
+	pthread_mutex_unlock(&g_keysound_lock);
 
 	debug_fleave();
-	return MM_ERROR_NONE;
+	return err;
+}
+
+EXPORT_API
+int mm_sound_play_keysound_id(int keytone_id, const volume_type_t vol_type)
+{
+	mm_sound_keytone_ipc_t data = {0,};
+	int err = MM_ERROR_NONE;
+
+	debug_fenter();
+
+	if (keytone_id < 0 || keytone_id >= KEYTONE_BANK_MAX)
+		return MM_ERROR_INVALID_ARGUMENT;
+
+	/* No file check here : the bank entry is already opened by the server */
+	data.version = KEYTONE_IPC_VERSION;
+	data.keytone_id = keytone_id;
+	data.vol_type = vol_type;
+
+	pthread_mutex_lock(&g_keysound_lock);
+	err = __mm_sound_keysound_write(&data, sizeof(mm_sound_keytone_ipc_t));
+	pthread_mutex_unlock(&g_keysound_lock);
+
+	return err;
 }
 
 
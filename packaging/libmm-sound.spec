@@ -41,7 +41,7 @@ Requires:   %{name}-devel = %{version}-%{release}
 MMSound development package for sound system
 
 %package tool
-Summary: MMSound utility package - contians mm_sound_testsuite, sound_check
+Summary: MMSound utility package - contians mm_sound_testsuite, sound_check, mm_sound_tonegen, mm_sound_bankgen
 Group:      TO_BE/FILLED_IN
 Requires:   %{name} = %{version}-%{release}
 
@@ -115,6 +115,7 @@ ln -s %{_sysconfdir}/rc.d/init.d/soundserver %{buildroot}%{_sysconfdir}/rc.d/rc4
 %{_libdir}/soundplugins/libsoundplugintone.so
 %{_libdir}/soundplugins/libsoundpluginwave.so
 %{_libdir}/soundplugins/libsoundpluginkeytone.so
+/usr/share/mm-sound/tone_table.bin
 %{_sysconfdir}/rc.d/init.d/soundserver
 %{_sysconfdir}/rc.d/rc3.d/S23soundserver
 %{_sysconfdir}/rc.d/rc4.d/S23soundserver
@@ -136,3 +137,5 @@ ln -s %{_sysconfdir}/rc.d/init.d/soundserver %{buildroot}%{_sysconfdir}/rc.d/rc4
 %files tool
 %defattr(-,root,root,-)
 %{_bindir}/mm_sound_testsuite
+%{_bindir}/mm_sound_tonegen
+%{_bindir}/mm_sound_bankgen
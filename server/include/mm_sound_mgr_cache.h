@@ -0,0 +1,38 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __MM_SOUND_MGR_CACHE_H__
+#define __MM_SOUND_MGR_CACHE_H__
+
+/*
+ * Pinned sound set : files listed in MM_SOUND_PINNED_LIST (one absolute path
+ * per line, '#' starts a comment) stay mapped and locked in memory, and the
+ * set is reloaded when the list or a listed file changes.
+ */
+#define MM_SOUND_PINNED_LIST		"/opt/etc/mmsound/pinned.list"
+#define MM_SOUND_PINNED_LIST_ENV	"MM_SOUND_PINNED_LIST"
+#define MM_SOUND_PINNED_MAX			32
+#define MM_SOUND_PINNED_MAX_BYTES	(8 * 1024 * 1024)
+
+int MMSoundMgrCacheInit(void);
+int MMSoundMgrCacheFini(void);
+
+#endif /* __MM_SOUND_MGR_CACHE_H__ */
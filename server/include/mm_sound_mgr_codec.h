@@ -24,6 +24,7 @@
 #define __MM_SOUND_MGR_CODEC_H__
 
 #include <mm_source.h>
+#include <mm_sound.h>
 
 typedef struct {
 	int tone;
@@ -43,6 +44,8 @@ typedef struct {
 	int volume_table;
 	int priority;
 	int handle_route;
+	const MMSoundToneSegment_t *segments;	/* User tone sequence, NULL for predefined tone */
+	int segment_count;
 } mmsound_mgr_codec_param_t;
 
 enum
@@ -0,0 +1,58 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __MM_SOUND_MGR_PRELOAD_H__
+#define __MM_SOUND_MGR_PRELOAD_H__
+
+enum {
+	MM_SOUND_PRELOAD_ENGINE_THREAD_POOL,
+	MM_SOUND_PRELOAD_ENGINE_IO_URING,
+};
+
+/* One file of a pack */
+typedef struct {
+	const char *filename;			/* in */
+	int result;						/* MM_ERROR_NONE when read through */
+	unsigned int size;				/* bytes read */
+	int is_wave;					/* RIFF/WAVE header found in the first block */
+	int channels;
+	int samplerate;
+	int format;						/* bits per sample */
+	unsigned int data_size;
+	long elapsed_us;				/* pack start to the end of this file */
+} mm_sound_preload_item_t;
+
+typedef struct {
+	int engine;						/* MM_SOUND_PRELOAD_ENGINE_XXX */
+	int loaded;
+	int failed;
+	unsigned long long bytes;
+	long elapsed_us;
+} mm_sound_preload_result_t;
+
+/*
+ * Read every file of the pack into the page cache, several at once, and
+ * check the WAV headers as the first block of each file arrives.
+ * Blocks until the whole pack is done.
+ */
+int MMSoundMgrPreload(mm_sound_preload_item_t *items, int count, mm_sound_preload_result_t *result);
+
+#endif /* __MM_SOUND_MGR_PRELOAD_H__ */
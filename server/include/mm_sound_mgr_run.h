@@ -26,5 +26,6 @@ int MMSoundMgrRunInit(const char *targetdir);
 int MMSoundMgrRunFini(void);
 int MMSoundMgrRunRunAll(void);
 int MMSoundMgrRunStopAll(void);
+int MMSoundMgrRunControl(int op, void *arg);
 
 #endif /* __MM_SOUND_MGR_RUN_H__ */
@@ -24,6 +24,7 @@
 
 #include "mm_sound_plugin.h"
 #include <mm_source.h>
+#include <mm_sound.h>
 #include <mm_types.h>
 
 enum MMSoundSupportedCodec {
@@ -41,6 +42,7 @@ typedef struct {
 	int format;
 	int doffset;
 	int size;
+	mm_sound_wav_info_t wav;	/* WAVE codec : the index of the source */
 } mmsound_codec_info_t;
 
 typedef struct {
@@ -55,6 +57,8 @@ typedef struct {
 	int keytone;
 	MMSourceType *source;
 	int handle_route;
+	const MMSoundToneSegment_t *segments;
+	int segment_count;
 } mmsound_codec_param_t;
 
 typedef struct {
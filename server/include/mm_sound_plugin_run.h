@@ -24,18 +24,27 @@
 
 #include "mm_sound_plugin.h"
 #include <mm_types.h>
+#include <mm_sound_private.h>
 
 enum {
     MM_SOUND_PLUG_RUN_OP_RUN,
     MM_SOUND_PLUG_RUN_OP_STOP,
+    MM_SOUND_PLUG_RUN_OP_KEYTONE_REGISTER,	/* arg : mmsound_run_keytone_register_t* */
+    MM_SOUND_PLUG_RUN_OP_KEYTONE_GET_STATS,	/* arg : mm_sound_keytone_stats_t* */
     MM_SOUND_PLUG_RUN_OP_LAST
 };
 
+typedef struct {
+    const char *filename;
+    int keytone_id;		/* out */
+} mmsound_run_keytone_register_t;
+
 /* Plugin Interface */
 typedef struct {
     int (*run)(void);
     int (*stop)(void);
     int (*SetThreadPool) (int (*)(void*, void (*)(void*)));
+    int (*control)(int op, void *arg);	/* optional, MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE for unknown op */
 } mmsound_run_interface_t;
 
 int MMSoundRunRun(void);
@@ -0,0 +1,59 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __MM_SOUND_TONE_TABLE_H__
+#define __MM_SOUND_TONE_TABLE_H__
+
+#include <stdint.h>
+
+/*
+ * Binary tone table, written by mm_sound_tonegen and mapped by the tone plugin.
+ *
+ * header | index[tone_count] | rows[row_count]
+ *
+ * Every tone is a run of rows in the row area, found by its index entry.
+ * A row holds MM_SOUND_TONE_TABLE_COLUMN values : low, middle and high frequency,
+ * playing time, loop count and loop index. All fields are in host byte order.
+ */
+
+#define MM_SOUND_TONE_TABLE_PATH	"/usr/share/mm-sound/tone_table.bin"
+#define MM_SOUND_TONE_TABLE_ENV		"MM_SOUND_TONE_TABLE"
+
+#define MM_SOUND_TONE_TABLE_MAGIC	0x4e544d4d	/* "MMTN" */
+#define MM_SOUND_TONE_TABLE_VERSION	1
+#define MM_SOUND_TONE_TABLE_COLUMN	6
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t column;			/* values per row */
+	uint32_t tone_count;
+	uint32_t row_count;
+	uint32_t index_offset;		/* from the beginning of the file */
+	uint32_t row_offset;
+} mm_sound_tone_table_header_t;
+
+typedef struct {
+	uint32_t first_row;
+	uint32_t row_count;			/* 0 : not defined */
+} mm_sound_tone_table_index_t;
+
+#endif /* __MM_SOUND_TONE_TABLE_H__ */
@@ -0,0 +1,321 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+
+#include <mm_error.h>
+#include <mm_debug.h>
+#include <mm_source.h>
+
+#include "include/mm_sound_mgr_cache.h"
+#include "include/mm_sound_mgr_preload.h"
+
+#define PINNED_RELOAD_DELAY_MS	200		/* let an editor finish writing before reloading */
+#define PINNED_EVENT_SIZE		4096
+
+typedef struct {
+	char filename[PATH_MAX];
+	MMSourceType source;
+	int wd;								/* inotify watch of the file */
+} pinned_entry_t;
+
+static pinned_entry_t g_pinned[MM_SOUND_PINNED_MAX];
+static int g_pinned_count = 0;
+
+static const char *g_list_path = NULL;
+static int g_inotify_fd = -1;
+static int g_list_wd = -1;				/* watch of the directory holding the list */
+static int g_stop_fd = -1;
+static pthread_t g_watch_thread;
+static int g_watch_started = 0;
+
+static void _pinned_unwatch(pinned_entry_t *set, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (set[i].wd != -1 && g_inotify_fd != -1)
+			inotify_rm_watch(g_inotify_fd, set[i].wd);
+		set[i].wd = -1;
+	}
+}
+
+static void _pinned_release(pinned_entry_t *set, int count)
+{
+	int i;
+
+	_pinned_unwatch(set, count);
+	for (i = 0; i < count; i++) {
+		mm_source_unpin(&set[i].source);
+		mm_source_close(&set[i].source);
+	}
+}
+
+/*
+ * Pin every file of the list. The whole list is preloaded in one batch
+ * first, so the opens below only map pages already in the page cache.
+ * The new set is pinned before the old one is released, so files kept in
+ * the list stay resident across the reload.
+ */
+static int _pinned_load(void)
+{
+	pinned_entry_t *set = NULL;
+	pinned_entry_t *entry;
+	mm_sound_preload_item_t items[MM_SOUND_PINNED_MAX];
+	mm_sound_preload_result_t preload;
+	mm_source_map_stats_t stats;
+	unsigned long long bytes = 0;
+	char line[PATH_MAX];
+	char *path, *end;
+	FILE *fp;
+	int listed = 0;
+	int count = 0;
+	int i;
+
+	set = (pinned_entry_t *)calloc(MM_SOUND_PINNED_MAX, sizeof(pinned_entry_t));
+	if (set == NULL) {
+		debug_error("memory alloc fail\n");
+		return MM_ERROR_OUT_OF_MEMORY;
+	}
+
+	/* A file kept in the list gets the same inode watched again */
+	_pinned_unwatch(g_pinned, g_pinned_count);
+
+	fp = fopen(g_list_path, "r");
+	if (fp == NULL) {
+		debug_msg("No pinned list %s, errno=[%d]\n", g_list_path, errno);
+	}
+
+	while (fp && fgets(line, sizeof(line), fp)) {
+		path = line;
+		while (*path == ' ' || *path == '\t')
+			path++;
+		end = strchr(path, '#');
+		if (end)
+			*end = '\0';
+		end = path + strlen(path);
+		while (end > path && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t'))
+			*--end = '\0';
+		if (*path == '\0')
+			continue;
+
+		if (path[0] != '/') {
+			debug_warning("Pinned file must be an absolute path [%s]\n", path);
+			continue;
+		}
+		if (listed >= MM_SOUND_PINNED_MAX) {
+			debug_warning("Too many pinned files, ignore [%s]\n", path);
+			continue;
+		}
+		strncpy(set[listed].filename, path, sizeof(set[listed].filename) - 1);
+		listed++;
+	}
+	if (fp)
+		fclose(fp);
+
+	memset(items, 0, sizeof(items));
+	for (i = 0; i < listed; i++)
+		items[i].filename = set[i].filename;
+	MMSoundMgrPreload(items, listed, &preload);
+
+	for (i = 0; i < listed; i++) {
+		if (items[i].result != MM_ERROR_NONE)
+			continue;
+
+		entry = &set[count];
+		if (entry != &set[i])
+			memcpy(entry->filename, set[i].filename, sizeof(entry->filename));
+		path = entry->filename;
+		if (mm_source_open_file(path, &entry->source, MM_SOURCE_NOT_DRM_CONTENTS) != MM_ERROR_NONE) {
+			debug_warning("Cannot open pinned file [%s]\n", path);
+			continue;
+		}
+		if (bytes + entry->source.tot_size > MM_SOUND_PINNED_MAX_BYTES) {
+			debug_warning("Pinned set over %d bytes, ignore [%s]\n", MM_SOUND_PINNED_MAX_BYTES, path);
+			mm_source_close(&entry->source);
+			continue;
+		}
+		mm_source_pin(&entry->source);
+		bytes += entry->source.tot_size;
+
+		entry->wd = -1;
+		if (g_inotify_fd != -1) {
+			entry->wd = inotify_add_watch(g_inotify_fd, path, IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+			if (entry->wd == -1)
+				debug_warning("Cannot watch pinned file [%s], errno=[%d]\n", path, errno);
+		}
+		count++;
+	}
+
+	_pinned_release(g_pinned, g_pinned_count);
+	memcpy(g_pinned, set, sizeof(pinned_entry_t) * count);
+	g_pinned_count = count;
+	free(set);
+
+	mm_source_get_map_stats(&stats);
+	debug_msg("Pinned %d files, %llu bytes (%llu bytes pinned, %llu bytes mapped)\n",
+			count, bytes, stats.pinned_bytes, stats.mapped_bytes);
+
+	return MM_ERROR_NONE;
+}
+
+/* True if the event is about the list file or one of the pinned files */
+static int _pinned_event_matches(const struct inotify_event *event, const char *list_name)
+{
+	int i;
+
+	if (event->wd == g_list_wd)
+		return (event->len && strcmp(event->name, list_name) == 0);
+
+	for (i = 0; i < g_pinned_count; i++) {
+		if (event->wd == g_pinned[i].wd)
+			return 1;
+	}
+	return 0;
+}
+
+static void *_pinned_watch_thread(void *data)
+{
+	char buf[PINNED_EVENT_SIZE] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	char list_copy[PATH_MAX];
+	const char *list_name;
+	const struct inotify_event *event;
+	struct pollfd pfd[2];
+	int changed;
+	int len;
+	char *pos;
+
+	strncpy(list_copy, g_list_path, sizeof(list_copy) - 1);
+	list_copy[sizeof(list_copy) - 1] = '\0';
+	list_name = basename(list_copy);
+
+	pfd[0].fd = g_inotify_fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = g_stop_fd;
+	pfd[1].events = POLLIN;
+
+	while (1) {
+		if (poll(pfd, 2, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			debug_error("poll failed. errno=[%d]\n", errno);
+			break;
+		}
+		if (pfd[1].revents)
+			break;
+
+		changed = 0;
+		do {
+			len = read(g_inotify_fd, buf, sizeof(buf));
+			for (pos = buf; len > 0 && pos < buf + len; pos += sizeof(struct inotify_event) + event->len) {
+				event = (const struct inotify_event *)pos;
+				if (_pinned_event_matches(event, list_name))
+					changed = 1;
+			}
+			/* Collect the rest of a burst of writes or renames */
+		} while (poll(pfd, 1, PINNED_RELOAD_DELAY_MS) > 0);
+
+		if (changed) {
+			debug_msg("Pinned list or a pinned file changed, reload\n");
+			_pinned_load();
+		}
+	}
+
+	return NULL;
+}
+
+int MMSoundMgrCacheInit(void)
+{
+	char dir_copy[PATH_MAX];
+
+	debug_enter("\n");
+
+	g_list_path = getenv(MM_SOUND_PINNED_LIST_ENV);
+	if (g_list_path == NULL)
+		g_list_path = MM_SOUND_PINNED_LIST;
+
+	g_inotify_fd = inotify_init();
+	if (g_inotify_fd == -1) {
+		debug_warning("inotify_init failed, errno=[%d], pinned set is not reloaded\n", errno);
+	} else {
+		strncpy(dir_copy, g_list_path, sizeof(dir_copy) - 1);
+		dir_copy[sizeof(dir_copy) - 1] = '\0';
+		/* Watch the directory, the list may be replaced by a rename */
+		g_list_wd = inotify_add_watch(g_inotify_fd, dirname(dir_copy), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+		if (g_list_wd == -1)
+			debug_warning("Cannot watch %s, errno=[%d]\n", g_list_path, errno);
+	}
+
+	/* Pinned at startup, before any sound is played */
+	_pinned_load();
+
+	if (g_inotify_fd != -1) {
+		g_stop_fd = eventfd(0, 0);
+		if (g_stop_fd != -1 && pthread_create(&g_watch_thread, NULL, _pinned_watch_thread, NULL) == 0) {
+			g_watch_started = 1;
+		} else {
+			debug_error("Cannot start pinned list watch, errno=[%d]\n", errno);
+		}
+	}
+
+	debug_leave("\n");
+	return MM_ERROR_NONE;
+}
+
+int MMSoundMgrCacheFini(void)
+{
+	uint64_t one = 1;
+
+	debug_enter("\n");
+
+	if (g_watch_started) {
+		if (write(g_stop_fd, &one, sizeof(one)) != sizeof(one))
+			debug_error("Fail to stop pinned list watch, errno=[%d]\n", errno);
+		pthread_join(g_watch_thread, NULL);
+		g_watch_started = 0;
+	}
+
+	_pinned_release(g_pinned, g_pinned_count);
+	g_pinned_count = 0;
+
+	if (g_stop_fd != -1) {
+		close(g_stop_fd);
+		g_stop_fd = -1;
+	}
+	if (g_inotify_fd != -1) {
+		close(g_inotify_fd);
+		g_inotify_fd = -1;
+	}
+
+	debug_leave("\n");
+	return MM_ERROR_NONE;
+}
@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 
 #include <mm_source.h>
 #include <mm_error.h>
@@ -53,6 +54,7 @@ typedef struct {
 	int status;
 	int session_type;
 	int session_handle;
+	struct timespec stop_time;	/* MMSoundMgrCodecStop() request, zero otherwise */
  } __mmsound_mgr_codec_handle_t;
 
 static MMSoundPluginType *g_codec_plugins = NULL;
@@ -341,6 +343,8 @@ int MMSoundMgrCodecPlayDtmf(int *slotid, const mmsound_mgr_codec_param_t *param)
 	}
 
 	codec_param.tone = param->tone;
+	codec_param.segments = param->segments;
+	codec_param.segment_count = param->segment_count;
 	codec_param.priority = 0;
 	codec_param.volume_table = param->volume_table;
 	codec_param.repeat_count = param->repeat_count;
@@ -425,6 +429,7 @@ int MMSoundMgrCodecStop(const int slotid)
 	}
 	debug_msg("Found slot, Slotid [%d] State [%d]\n", slotid, g_slots[slotid].status);
 
+	clock_gettime(CLOCK_MONOTONIC, &g_slots[slotid].stop_time);
 	err = g_plugins[g_slots[slotid].pluginid].Stop(g_slots[slotid].plughandle);
 	if (err != MM_ERROR_NONE) {
 		debug_error("Fail to STOP Code : 0x%08X\n", err);
@@ -441,12 +446,20 @@ cleanup:
 static int _MMSoundMgrCodecStopCallback(int param)
 {
 	int err = MM_ERROR_NONE;
+	struct timespec now;
 
 	debug_enter("(Slot : %d)\n", param);
 
 	pthread_mutex_lock(&g_slot_mutex);
 	debug_msg("[CODEC MGR] Slot_mutex lock done\n");
 
+	if (g_slots[param].stop_time.tv_sec || g_slots[param].stop_time.tv_nsec) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		debug_msg("[CODEC MGR] Slot %d released %ld us after the stop request\n", param,
+				(long)(now.tv_sec - g_slots[param].stop_time.tv_sec) * 1000000L +
+				(now.tv_nsec - g_slots[param].stop_time.tv_nsec) / 1000);
+	}
+
 
 	/*
 	 * Unregister ASM here
@@ -38,8 +38,12 @@
 #include "include/mm_sound_thread_pool.h"
 #include "include/mm_sound_mgr_codec.h"
 #include "include/mm_sound_mgr_device.h"
+#include "include/mm_sound_mgr_run.h"
+#include "include/mm_sound_mgr_preload.h"
+#include "include/mm_sound_plugin_run.h"
 #include <mm_error.h>
 #include <mm_debug.h>
+#include <mm_sound_pool.h>
 
 #include <audio-session-manager.h>
 
@@ -53,6 +57,11 @@
 int g_rcvid;
 int g_sndid;
 int g_cbid;
+int g_dataid;
+
+/* Requests queued to the thread pool, more than this many come from malloc() */
+#define MSG_POOL_COUNT	16
+static mm_sound_pool_t g_msg_pool = MM_SOUND_POOL_INITIALIZER("ipc msg", sizeof(mm_ipc_msg_t), MSG_POOL_COUNT);
 
 
 /* Msg processing */
@@ -62,6 +71,9 @@ static int _MMSoundMgrIpcPlayFile(int *codechandle, mm_ipc_msg_t *msg);	/* codec
 static int _MMSoundMgrIpcPlayMemory(int *codechandle, mm_ipc_msg_t *msg);
 static int _MMSoundMgrIpcStop(mm_ipc_msg_t *msg);
 static int _MMSoundMgrIpcPlayDTMF(int *codechandle, mm_ipc_msg_t *msg);
+static int _MMSoundMgrIpcPlayToneSequence(int *codechandle, mm_ipc_msg_t *msg);
+static int _MMSoundMgrIpcRegisterKeytone(int *keytone_id, mm_ipc_msg_t *msg);
+static int _MMSoundMgrIpcPreloadPack(mm_ipc_msg_t *msg);
 static int __mm_sound_mgr_ipc_is_route_available(mm_ipc_msg_t *msg, bool *is_available);
 static int __mm_sound_mgr_ipc_foreach_available_route_cb(mm_ipc_msg_t *msg);
 static int __mm_sound_mgr_ipc_set_active_route(mm_ipc_msg_t *msg);
@@ -72,6 +84,8 @@ static int __mm_sound_mgr_ipc_add_available_device_changed_cb(mm_ipc_msg_t *msg)
 static int __mm_sound_mgr_ipc_remove_available_device_changed_cb(mm_ipc_msg_t *msg);
 static int _MMIpcRecvMsg(int msgtype, mm_ipc_msg_t *msg);
 static int _MMIpcSndMsg(mm_ipc_msg_t *msg);
+static int _MMIpcDataSnd(int instance, mm_ipc_data_msg_t *data, int size);
+static int _MMIpcDataRecv(int instance, mm_ipc_data_msg_t *data);
 
 int MMSoundMgrIpcInit(void)
 {
@@ -82,8 +96,9 @@ int MMSoundMgrIpcInit(void)
 	g_rcvid = msgget(ftok(KEY_BASE_PATH, RCV_MSG), IPC_CREAT |0666);
 	g_sndid = msgget(ftok(KEY_BASE_PATH, SND_MSG), IPC_CREAT |0666);
 	g_cbid = msgget(ftok(KEY_BASE_PATH, CB_MSG), IPC_CREAT |0666);
+	g_dataid = msgget(ftok(KEY_BASE_PATH, DATA_MSG), IPC_CREAT |0666);
 
-	if ((g_rcvid == -1 || g_sndid == -1 || g_cbid == -1) != MM_ERROR_NONE) {
+	if ((g_rcvid == -1 || g_sndid == -1 || g_cbid == -1 || g_dataid == -1) != MM_ERROR_NONE) {
 		if(errno == EACCES)
 			printf("Require ROOT permission.\n");
 		else if(errno == EEXIST)
@@ -101,6 +116,7 @@ int MMSoundMgrIpcInit(void)
 	debug_msg("Created server msg queue id : [%d]\n", g_rcvid);
 	debug_msg("Created server msg queue id : [%d]\n", g_sndid);
 	debug_msg("Created server msg queue id : [%d]\n", g_cbid);
+	debug_msg("Created server msg queue id : [%d]\n", g_dataid);
 	
 	debug_fleave();
 	return MM_ERROR_NONE;
@@ -114,7 +130,7 @@ int MMSoundMgrIpcFini(void)
 int MMSoundMgrIpcReady(void)
 {
 	int ret = MM_ERROR_NONE;
-	int err1, err2, err3;
+	int err1, err2, err3, err4;
 	mm_ipc_msg_t msg = {0,};
 	mm_ipc_msg_t resp  = {0,};
 
@@ -155,6 +171,10 @@ int MMSoundMgrIpcReady(void)
 #endif
 		case MM_SOUND_MSG_REQ_IS_BT_A2DP_ON:
 		case MM_SOUND_MSG_REQ_DTMF:
+		case MM_SOUND_MSG_REQ_TONE_SEQUENCE:
+		case MM_SOUND_MSG_REQ_KEYTONE_REGISTER:
+		case MM_SOUND_MSG_REQ_KEYTONE_STATS:
+		case MM_SOUND_MSG_REQ_PRELOAD_PACK:
 		case MM_SOUND_MSG_REQ_IS_ROUTE_AVAILABLE:
 		case MM_SOUND_MSG_REQ_FOREACH_AVAILABLE_ROUTE_CB:
 		case MM_SOUND_MSG_REQ_SET_ACTIVE_ROUTE:
@@ -165,7 +185,7 @@ int MMSoundMgrIpcReady(void)
 		case MM_SOUND_MSG_REQ_REMOVE_AVAILABLE_ROUTE_CB:
 			{
 				/* Create msg to queue : this will be freed inside thread function after use */
-				mm_ipc_msg_t* msg_to_queue = malloc (sizeof(mm_ipc_msg_t));
+				mm_ipc_msg_t* msg_to_queue = mm_sound_pool_alloc (&g_msg_pool, sizeof(mm_ipc_msg_t));
 				if (msg_to_queue) {
 					memcpy (msg_to_queue, &msg, sizeof (mm_ipc_msg_t));
 					debug_msg ("func = %p, alloc param(msg_to_queue) = %p\n", _MMSoundMgrRun, msg_to_queue);
@@ -174,6 +194,7 @@ int MMSoundMgrIpcReady(void)
 					if (ret != MM_ERROR_NONE) {
 						/* Do not send msg in Ready, Just print log */
 						debug_critical("Fail to run thread [MgrRun]");
+						mm_sound_pool_free(&g_msg_pool, msg_to_queue);
 	
 						SOUND_MSG_SET(resp.sound_msg, MM_SOUND_MSG_RES_ERROR, ret, -1, msg.sound_msg.msgid);
 						ret = _MMIpcSndMsg(&resp);
@@ -202,8 +223,9 @@ int MMSoundMgrIpcReady(void)
 	err1 = msgctl(g_rcvid, IPC_RMID, NULL);
 	err2 = msgctl(g_sndid, IPC_RMID, NULL);
 	err3 = msgctl(g_cbid, IPC_RMID, NULL);
+	err4 = msgctl(g_dataid, IPC_RMID, NULL);
 	
-	if (err1 == -1 ||err2 == -1 ||err3 ==-1) {
+	if (err1 == -1 ||err2 == -1 ||err3 ==-1 ||err4 == -1) {
 		debug_error("Base message node destroy fail");
 		return MM_ERROR_SOUND_INTERNAL;
 	}
@@ -281,6 +303,57 @@ static void _MMSoundMgrRun(mm_ipc_msg_t *msg)
 		}
 		break;
 
+	case MM_SOUND_MSG_REQ_TONE_SEQUENCE:
+		debug_msg("Recv TONE SEQUENCE msg\n");
+		ret = _MMSoundMgrIpcPlayToneSequence(&handle, msg);
+		if ( ret != MM_ERROR_NONE) {
+			debug_error("Error to MM_SOUND_MSG_REQ_TONE_SEQUENCE.\n");
+			SOUND_MSG_SET(respmsg.sound_msg, MM_SOUND_MSG_RES_ERROR, -1, ret, instance);
+		} else {
+			SOUND_MSG_SET(respmsg.sound_msg, MM_SOUND_MSG_RES_TONE_SEQUENCE, handle, MM_ERROR_NONE, instance);
+		}
+		break;
+
+	case MM_SOUND_MSG_REQ_KEYTONE_REGISTER:
+		debug_msg("Recv KEYTONE REGISTER msg\n");
+		ret = _MMSoundMgrIpcRegisterKeytone(&handle, msg);
+		if ( ret != MM_ERROR_NONE) {
+			debug_error("Error to MM_SOUND_MSG_REQ_KEYTONE_REGISTER.\n");
+			SOUND_MSG_SET(respmsg.sound_msg, MM_SOUND_MSG_RES_ERROR, -1, ret, instance);
+		} else {
+			SOUND_MSG_SET(respmsg.sound_msg, MM_SOUND_MSG_RES_KEYTONE_REGISTER, -1, MM_ERROR_NONE, instance);
+			respmsg.sound_msg.keytone = handle;
+		}
+		break;
+
+	case MM_SOUND_MSG_REQ_KEYTONE_STATS:
+		debug_msg("Recv KEYTONE STATS msg\n");
+		{
+			mm_ipc_data_msg_t data;
+
+			ret = MMSoundMgrRunControl(MM_SOUND_PLUG_RUN_OP_KEYTONE_GET_STATS, &data.data.keytone_stats);
+			if (ret == MM_ERROR_NONE)
+				ret = _MMIpcDataSnd(instance, &data, sizeof(mm_sound_keytone_stats_t));
+		}
+		if ( ret != MM_ERROR_NONE) {
+			debug_error("Error to MM_SOUND_MSG_REQ_KEYTONE_STATS.\n");
+			SOUND_MSG_SET(respmsg.sound_msg, MM_SOUND_MSG_RES_ERROR, -1, ret, instance);
+		} else {
+			SOUND_MSG_SET(respmsg.sound_msg, MM_SOUND_MSG_RES_KEYTONE_STATS, -1, MM_ERROR_NONE, instance);
+		}
+		break;
+
+	case MM_SOUND_MSG_REQ_PRELOAD_PACK:
+		debug_msg("Recv PRELOAD PACK msg\n");
+		ret = _MMSoundMgrIpcPreloadPack(msg);
+		if ( ret != MM_ERROR_NONE) {
+			debug_error("Error to MM_SOUND_MSG_REQ_PRELOAD_PACK.\n");
+			SOUND_MSG_SET(respmsg.sound_msg, MM_SOUND_MSG_RES_ERROR, -1, ret, instance);
+		} else {
+			SOUND_MSG_SET(respmsg.sound_msg, MM_SOUND_MSG_RES_PRELOAD_PACK, -1, MM_ERROR_NONE, instance);
+		}
+		break;
+
 	case MM_SOUND_MSG_REQ_IS_ROUTE_AVAILABLE:
 		debug_msg("Recv REQ_SET_ACTIVE_ROUTE msg\n");
 		ret = __mm_sound_mgr_ipc_is_route_available(msg, &is_available);
@@ -389,7 +462,7 @@ static void _MMSoundMgrRun(mm_ipc_msg_t *msg)
 
 	if (msg) {
 		debug_log ("Free mm_ipc_msg_t [%p]\n", msg);
-		free (msg);
+		mm_sound_pool_free (&g_msg_pool, msg);
 	}
 
 	debug_msg("Ready to next msg\n");
@@ -426,13 +499,22 @@ static int _MMSoundMgrIpcPlayFile(int *codechandle, mm_ipc_msg_t *msg)
 	debug_fenter();
 
 	/* Set source */
-	source = (MMSourceType*)malloc(sizeof(MMSourceType));
+	source = mm_source_alloc();
+
+	if (source == NULL) {
+		debug_error("memory alloc fail\n");
+		return MM_ERROR_OUT_OF_MEMORY;
+	}
 
-	ret = mm_source_open_file(msg->sound_msg.filename, source, MM_SOURCE_CHECK_DRM_CONTENTS);
+	if (msg->sound_msg.bank_name[0] != '\0') {
+		msg->sound_msg.bank_name[sizeof(msg->sound_msg.bank_name) - 1] = '\0';
+		ret = mm_source_open_bank(msg->sound_msg.filename, msg->sound_msg.bank_name, source);
+	} else {
+		ret = mm_source_open_file(msg->sound_msg.filename, source, MM_SOURCE_CHECK_DRM_CONTENTS);
+	}
 	if(ret != MM_ERROR_NONE) {
 		debug_error("Fail to open file\n");
-		if (source)
-			free(source);
+		mm_source_free(source);
 		return ret;		
 	}
 
@@ -546,12 +628,12 @@ static int _MMSoundMgrIpcPlayMemory(int *codechandle, mm_ipc_msg_t *msg)
 		return MM_ERROR_SOUND_INTERNAL;
 	}
 
-	source = (MMSourceType*)malloc(sizeof(MMSourceType));
+	source = mm_source_alloc();
 
 	if (mm_source_open_full_memory(shmat(shmid, 0, 0), msg->sound_msg.memsize, 0, source) != MM_ERROR_NONE)
 	{
 		debug_error("Fail to set source\n");
-		free(source);
+		mm_source_free(source);
 		return MM_ERROR_SOUND_INTERNAL;
 	}
 #else
@@ -577,7 +659,7 @@ static int _MMSoundMgrIpcPlayMemory(int *codechandle, mm_ipc_msg_t *msg)
 	}
 
 	/* Set source */
-	source = (MMSourceType*)malloc(sizeof(MMSourceType));
+	source = mm_source_alloc();
 	if(!source) {
 		debug_error("Can not allocate memory");
 		return MM_ERROR_OUT_OF_MEMORY;
@@ -585,7 +667,7 @@ static int _MMSoundMgrIpcPlayMemory(int *codechandle, mm_ipc_msg_t *msg)
 
 	if (mm_source_open_full_memory(mmap_buf, msg->sound_msg.memsize, 0, source) != MM_ERROR_NONE) {
 		debug_error("Fail to set source\n");
-		free(source);
+		mm_source_free(source);
 		return MM_ERROR_SOUND_INTERNAL;
 	}
 #endif	
@@ -618,8 +700,7 @@ static int _MMSoundMgrIpcPlayMemory(int *codechandle, mm_ipc_msg_t *msg)
 	if ( ret != MM_ERROR_NONE) {
 		debug_error("Will be closed a sources, codec handle : [0x%d]\n", *codechandle);
 		mm_source_close(source);
-		if (source)
-			free(source);
+		mm_source_free(source);
 		return ret;		
 	}
 
@@ -665,6 +746,138 @@ static int _MMSoundMgrIpcPlayDTMF(int *codechandle, mm_ipc_msg_t *msg)
 	return ret;
 }
 
+static int _MMSoundMgrIpcPlayToneSequence(int *codechandle, mm_ipc_msg_t *msg)
+{
+	mmsound_mgr_codec_param_t param = {0,};
+	mm_ipc_data_msg_t data;
+	int ret = MM_ERROR_NONE;
+	int size;
+
+	debug_fenter();
+
+	size = _MMIpcDataRecv(msg->sound_msg.msgid, &data);
+	if (size < 0 || size != msg->sound_msg.segment_count * (int)sizeof(MMSoundToneSegment_t)) {
+		debug_error("Segments of the tone sequence are missing, %d bytes for %d segments\n", size, msg->sound_msg.segment_count);
+		return MM_ERROR_SOUND_INTERNAL;
+	}
+
+	/* Set sound player parameter, segments are validated and copied by the tone plugin */
+	param.tone = -1;
+	param.segments = data.data.segments;
+	param.segment_count = msg->sound_msg.segment_count;
+	param.repeat_count = msg->sound_msg.repeat;
+	param.param = (void*)msg->sound_msg.msgid;
+	param.volume = msg->sound_msg.volume;
+	param.volume_table = msg->sound_msg.volume_table;
+	param.priority = msg->sound_msg.priority;
+	param.callback = _MMSoundMgrStopCB;
+	param.msgcallback = msg->sound_msg.callback;
+	param.msgdata = msg->sound_msg.cbdata;
+	param.session_type = ASM_EVENT_SHARE_MMSOUND;
+
+	debug_msg("Segments %d\n", param.segment_count);
+	debug_msg("Loop %d\n", param.repeat_count);
+	debug_msg("VolumeTable %d\n",param.volume_table);
+	debug_msg("param %d\n", (int)param.param);
+
+	ret = MMSoundMgrCodecPlayDtmf(codechandle, &param);
+	if ( ret != MM_ERROR_NONE) {
+		debug_error("Fail to play tone sequence, codec handle : [0x%d]\n", *codechandle);
+		return ret;
+	}
+
+	debug_fleave();
+	return ret;
+}
+
+static int _MMSoundMgrIpcRegisterKeytone(int *keytone_id, mm_ipc_msg_t *msg)
+{
+	mmsound_run_keytone_register_t reg = {0,};
+	int ret = MM_ERROR_NONE;
+
+	debug_fenter();
+
+	msg->sound_msg.filename[FILE_PATH-1] = '\0';
+	reg.filename = msg->sound_msg.filename;
+	reg.keytone_id = -1;
+
+	ret = MMSoundMgrRunControl(MM_SOUND_PLUG_RUN_OP_KEYTONE_REGISTER, &reg);
+	if (ret != MM_ERROR_NONE) {
+		debug_error("Fail to register keytone [%s] : %x\n", reg.filename, ret);
+		return ret;
+	}
+	*keytone_id = reg.keytone_id;
+
+	debug_fleave();
+	return ret;
+}
+
+static int _MMSoundMgrIpcPreloadPack(mm_ipc_msg_t *msg)
+{
+	mm_ipc_preload_entry_t *entries = MAP_FAILED;
+	mm_sound_preload_item_t *items = NULL;
+	mm_sound_preload_result_t result = {0,};
+	size_t size = 0;
+	int count = 0;
+	int shm_fd = -1;
+	int ret = MM_ERROR_NONE;
+	int i;
+
+	debug_fenter();
+
+	if (msg->sound_msg.memsize <= 0 || msg->sound_msg.memsize % sizeof(mm_ipc_preload_entry_t)
+		|| msg->sound_msg.memsize / sizeof(mm_ipc_preload_entry_t) > MM_SOUND_PRELOAD_PACK_MAX) {
+		debug_error("Invalid pack of %d bytes\n", msg->sound_msg.memsize);
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+	size = msg->sound_msg.memsize;
+	count = size / sizeof(mm_ipc_preload_entry_t);
+
+	msg->sound_msg.filename[FILE_PATH-1] = '\0';
+	shm_fd = shm_open(msg->sound_msg.filename, O_RDWR, 0666);
+	if (shm_fd < 0) {
+		debug_error("Fail to open the pack [%s], errno %d\n", msg->sound_msg.filename, errno);
+		return MM_ERROR_SOUND_INTERNAL;
+	}
+	entries = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	close(shm_fd);
+	if (entries == MAP_FAILED) {
+		debug_error("Fail to mmap the pack\n");
+		return MM_ERROR_SOUND_INTERNAL;
+	}
+
+	items = calloc(count, sizeof(mm_sound_preload_item_t));
+	if (items == NULL) {
+		debug_error("Fail to allocate %d preload items\n", count);
+		ret = MM_ERROR_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+	for (i = 0; i < count; i++) {
+		entries[i].filename[FILE_PATH-1] = '\0';
+		items[i].filename = entries[i].filename;
+	}
+
+	ret = MMSoundMgrPreload(items, count, &result);
+	if (ret != MM_ERROR_NONE) {
+		debug_error("Fail to preload the pack : %x\n", ret);
+		goto cleanup;
+	}
+
+	for (i = 0; i < count; i++) {
+		entries[i].status.result = items[i].result;
+		entries[i].status.size = items[i].size;
+		entries[i].status.elapsed_us = items[i].elapsed_us;
+	}
+	debug_msg("Preloaded %d of %d files, %llu bytes in %ld us\n", result.loaded, count, result.bytes, result.elapsed_us);
+
+cleanup:
+	free(items);
+	munmap(entries, size);
+
+	debug_fleave();
+	return ret;
+}
+
 static int __mm_sound_mgr_ipc_is_route_available(mm_ipc_msg_t *msg, bool *is_available)
 {
 	_mm_sound_mgr_device_param_t param;
@@ -847,6 +1060,30 @@ int _MMIpcSndMsg(mm_ipc_msg_t *msg)
 	return MM_ERROR_NONE;
 }
 
+/* Sends 'size' bytes of payload to the client, ahead of the response they belong to */
+static int _MMIpcDataSnd(int instance, mm_ipc_data_msg_t *data, int size)
+{
+	data->msg_type = instance;
+	if (msgsnd(g_dataid, data, size, 0) == -1) {
+		debug_critical("Fail to send data msg queue : [%d], errno [%d]\n", g_dataid, errno);
+		return MM_ERROR_SOUND_INTERNAL;
+	}
+	return MM_ERROR_NONE;
+}
+
+/* Receives the payload the client sent ahead of its request, returns its size or -1 */
+static int _MMIpcDataRecv(int instance, mm_ipc_data_msg_t *data)
+{
+	ssize_t size;
+
+	size = msgrcv(g_dataid, data, sizeof(data->data), instance, IPC_NOWAIT);
+	if (size == -1) {
+		debug_warning("Fail to receive data msg queue : [%d], errno [%d]\n", g_dataid, errno);
+		return -1;
+	}
+	return (int)size;
+}
+
 int _MMIpcCBSndMsg(mm_ipc_msg_t *msg)
 {
 	/* rcv message */
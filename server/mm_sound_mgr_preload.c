@@ -0,0 +1,493 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#ifdef USE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include <mm_error.h>
+#include <mm_debug.h>
+#include <mm_sound_wav.h>
+
+#include "include/mm_sound_thread_pool.h"
+#include "include/mm_sound_mgr_preload.h"
+
+#define PRELOAD_BLOCK_SIZE		(64 * 1024)		/* first block holds the WAV header */
+#define PRELOAD_DEPTH			16				/* files in flight on the ring */
+#define PRELOAD_WORKERS			4				/* thread pool fallback */
+
+/*
+ * Index the first block. Files which are not RIFF/WAVE (mp3, ...) are only
+ * read; a WAVE file which the players could not index fails.
+ */
+static void _preload_parse_header(mm_sound_preload_item_t *item, const unsigned char *buf, int len)
+{
+	mm_sound_wav_info_t wav;
+
+	if (len < 12 || memcmp(buf, "RIFF", 4) != 0 || memcmp(buf + 8, "WAVE", 4) != 0)
+		return;
+
+	if (mm_sound_wav_index(buf, len, &wav) != MM_ERROR_NONE) {
+		debug_error("Broken or unsupported WAV header [%s]\n", item->filename);
+		item->result = MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+		return;
+	}
+	item->is_wave = 1;
+	item->channels = wav.channels;
+	item->samplerate = wav.samplerate;
+	item->format = wav.bits;
+	item->data_size = wav.data_declared;
+}
+
+static void _preload_stamp(mm_sound_preload_item_t *item, const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	item->elapsed_us = (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static void _preload_done(mm_sound_preload_item_t *item, mm_sound_preload_result_t *result)
+{
+	if (item->result == MM_ERROR_NONE)
+		result->loaded++;
+	else
+		result->failed++;
+	result->bytes += item->size;
+}
+
+/********************************* Thread pool *********************************/
+
+typedef struct {
+	mm_sound_preload_item_t *items;
+	int count;
+	volatile int next;
+	int running;
+	struct timespec start;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} preload_job_t;
+
+static void _preload_file(mm_sound_preload_item_t *item, unsigned char *buf)
+{
+	int fd;
+	int len;
+
+	fd = open(item->filename, O_RDONLY);
+	if (fd == -1) {
+		debug_warning("Cannot open [%s], errno=[%d]\n", item->filename, errno);
+		item->result = MM_ERROR_SOUND_FILE_NOT_FOUND;
+		return;
+	}
+
+	while ((len = read(fd, buf, PRELOAD_BLOCK_SIZE)) > 0) {
+		if (item->size == 0)
+			_preload_parse_header(item, buf, len);
+		item->size += len;
+		if (len < PRELOAD_BLOCK_SIZE)
+			break;
+	}
+	if (len < 0) {
+		debug_warning("Cannot read [%s], errno=[%d]\n", item->filename, errno);
+		item->result = MM_ERROR_SOUND_INTERNAL;
+	}
+	close(fd);
+}
+
+static void _preload_worker(void *param)
+{
+	preload_job_t *job = (preload_job_t *)param;
+	unsigned char *buf;
+	int index;
+
+	buf = (unsigned char *)malloc(PRELOAD_BLOCK_SIZE);
+	while (buf && (index = __sync_fetch_and_add(&job->next, 1)) < job->count) {
+		_preload_file(&job->items[index], buf);
+		_preload_stamp(&job->items[index], &job->start);
+	}
+	free(buf);
+
+	pthread_mutex_lock(&job->lock);
+	job->running--;
+	pthread_cond_signal(&job->cond);
+	pthread_mutex_unlock(&job->lock);
+}
+
+static int _preload_thread_pool(mm_sound_preload_item_t *items, int count, const struct timespec *start)
+{
+	preload_job_t job;
+	int workers = (count < PRELOAD_WORKERS) ? count : PRELOAD_WORKERS;
+	int i;
+
+	memset(&job, 0, sizeof(preload_job_t));
+	job.items = items;
+	job.count = count;
+	job.start = *start;
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_cond_init(&job.cond, NULL);
+
+	for (i = 0; i < workers; i++) {
+		pthread_mutex_lock(&job.lock);
+		job.running++;
+		pthread_mutex_unlock(&job.lock);
+		if (MMSoundThreadPoolRun(&job, _preload_worker) != MM_ERROR_NONE) {
+			pthread_mutex_lock(&job.lock);
+			job.running--;
+			pthread_mutex_unlock(&job.lock);
+			break;
+		}
+	}
+	/* Nothing started : do it here */
+	if (i == 0) {
+		job.running++;
+		_preload_worker(&job);
+	}
+
+	pthread_mutex_lock(&job.lock);
+	while (job.running)
+		pthread_cond_wait(&job.cond, &job.lock);
+	pthread_mutex_unlock(&job.lock);
+
+	pthread_cond_destroy(&job.cond);
+	pthread_mutex_destroy(&job.lock);
+
+	return MM_ERROR_NONE;
+}
+
+/********************************* io_uring *********************************/
+
+#ifdef USE_IO_URING
+
+enum {
+	SLOT_FREE,
+	SLOT_OPEN,
+	SLOT_READ,
+};
+
+typedef struct {
+	int state;
+	int index;						/* item */
+	int fd;
+	unsigned long long offset;
+	unsigned char *buf;
+} preload_slot_t;
+
+typedef struct {
+	int fd;
+	void *sq_ptr;
+	void *cq_ptr;
+	size_t sq_len;
+	size_t cq_len;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+	unsigned to_submit;
+} preload_ring_t;
+
+static int _preload_ring_init(preload_ring_t *ring, unsigned entries)
+{
+	struct io_uring_params params;
+
+	memset(ring, 0, sizeof(preload_ring_t));
+	memset(&params, 0, sizeof(params));
+
+	ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0) {
+		debug_msg("io_uring_setup failed, errno=[%d]\n", errno);
+		return MM_ERROR_SOUND_INTERNAL;
+	}
+
+	ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_len > ring->sq_len)
+			ring->sq_len = ring->cq_len;
+		ring->cq_len = ring->sq_len;
+	}
+
+	ring->sq_ptr = mmap(0, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED)
+		goto fail;
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ptr = ring->sq_ptr;
+	} else {
+		ring->cq_ptr = mmap(0, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED)
+			goto fail;
+	}
+	ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(0, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto fail;
+
+	ring->sq_head = (unsigned *)((char *)ring->sq_ptr + params.sq_off.head);
+	ring->sq_tail = (unsigned *)((char *)ring->sq_ptr + params.sq_off.tail);
+	ring->sq_mask = (unsigned *)((char *)ring->sq_ptr + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)((char *)ring->sq_ptr + params.sq_off.array);
+	ring->cq_head = (unsigned *)((char *)ring->cq_ptr + params.cq_off.head);
+	ring->cq_tail = (unsigned *)((char *)ring->cq_ptr + params.cq_off.tail);
+	ring->cq_mask = (unsigned *)((char *)ring->cq_ptr + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ptr + params.cq_off.cqes);
+
+	return MM_ERROR_NONE;
+
+fail:
+	debug_error("io_uring mmap failed, errno=[%d]\n", errno);
+	if (ring->sq_ptr && ring->sq_ptr != MAP_FAILED)
+		munmap(ring->sq_ptr, ring->sq_len);
+	if (ring->cq_ptr && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_len);
+	close(ring->fd);
+	return MM_ERROR_SOUND_INTERNAL;
+}
+
+static void _preload_ring_fini(preload_ring_t *ring)
+{
+	munmap(ring->sqes, ring->sqes_len);
+	if (ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_len);
+	munmap(ring->sq_ptr, ring->sq_len);
+	close(ring->fd);
+}
+
+/* Queue one operation, PRELOAD_DEPTH never exceeds the ring size */
+static struct io_uring_sqe *_preload_ring_sqe(preload_ring_t *ring, int slot)
+{
+	unsigned tail = *ring->sq_tail;
+	unsigned index = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->user_data = slot;
+	ring->sq_array[index] = index;
+	__sync_synchronize();	/* entry before the tail */
+	*ring->sq_tail = tail + 1;
+	ring->to_submit++;
+
+	return sqe;
+}
+
+static void _preload_ring_open(preload_ring_t *ring, int slot, const char *filename)
+{
+	struct io_uring_sqe *sqe = _preload_ring_sqe(ring, slot);
+
+	sqe->opcode = IORING_OP_OPENAT;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (unsigned long)filename;
+	sqe->open_flags = O_RDONLY | O_CLOEXEC;
+}
+
+static void _preload_ring_read(preload_ring_t *ring, int slot, preload_slot_t *s)
+{
+	struct io_uring_sqe *sqe = _preload_ring_sqe(ring, slot);
+
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = s->fd;
+	sqe->addr = (unsigned long)s->buf;
+	sqe->len = PRELOAD_BLOCK_SIZE;
+	sqe->off = s->offset;
+}
+
+/*
+ * Keep PRELOAD_DEPTH files in flight : an open completion queues the first
+ * read, a full read queues the next one, a short read ends the file.
+ * Returns MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE if the kernel does not know
+ * the operations, then nothing of the pack is reported.
+ */
+static int _preload_io_uring(mm_sound_preload_item_t *items, int count, const struct timespec *start)
+{
+	preload_ring_t ring;
+	preload_slot_t slot[PRELOAD_DEPTH];
+	preload_slot_t *s;
+	mm_sound_preload_item_t *item;
+	struct io_uring_cqe *cqe;
+	unsigned char *bufs;
+	unsigned head, tail;
+	int unsupported = 0;
+	int inflight = 0;
+	int next = 0;
+	int ret = MM_ERROR_NONE;
+	int res;
+	int i;
+
+	if (_preload_ring_init(&ring, PRELOAD_DEPTH) != MM_ERROR_NONE)
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+
+	bufs = (unsigned char *)malloc(PRELOAD_BLOCK_SIZE * PRELOAD_DEPTH);
+	if (bufs == NULL) {
+		_preload_ring_fini(&ring);
+		return MM_ERROR_OUT_OF_MEMORY;
+	}
+	memset(slot, 0, sizeof(slot));
+	for (i = 0; i < PRELOAD_DEPTH; i++) {
+		slot[i].buf = bufs + i * PRELOAD_BLOCK_SIZE;
+		slot[i].fd = -1;
+	}
+
+	while (next < count || inflight) {
+		for (i = 0; i < PRELOAD_DEPTH && next < count && !unsupported; i++) {
+			if (slot[i].state != SLOT_FREE)
+				continue;
+			slot[i].state = SLOT_OPEN;
+			slot[i].index = next++;
+			slot[i].offset = 0;
+			_preload_ring_open(&ring, i, items[slot[i].index].filename);
+			inflight++;
+		}
+		if (unsupported && inflight == 0)
+			break;
+
+		res = syscall(__NR_io_uring_enter, ring.fd, ring.to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			debug_error("io_uring_enter failed, errno=[%d]\n", errno);
+			ret = MM_ERROR_SOUND_INTERNAL;
+			break;
+		}
+		ring.to_submit -= res;
+
+		head = *ring.cq_head;
+		tail = *ring.cq_tail;
+		__sync_synchronize();	/* tail before the entries */
+		while (head != tail) {
+			cqe = &ring.cqes[head & *ring.cq_mask];
+			s = &slot[cqe->user_data];
+			item = &items[s->index];
+			res = cqe->res;
+			head++;
+
+			if (s->state == SLOT_OPEN) {
+				if (res == -EINVAL || res == -EOPNOTSUPP) {
+					unsupported = 1;
+				} else if (res < 0) {
+					debug_warning("Cannot open [%s], errno=[%d]\n", item->filename, -res);
+					item->result = MM_ERROR_SOUND_FILE_NOT_FOUND;
+				} else {
+					s->fd = res;
+					s->state = SLOT_READ;
+					if (!unsupported) {
+						_preload_ring_read(&ring, cqe->user_data, s);
+						continue;
+					}
+				}
+			} else {
+				if (res == -EINVAL && s->offset == 0) {
+					unsupported = 1;
+				} else if (res < 0) {
+					debug_warning("Cannot read [%s], errno=[%d]\n", item->filename, -res);
+					item->result = MM_ERROR_SOUND_INTERNAL;
+				} else {
+					/* Header check as soon as the first block is in */
+					if (s->offset == 0)
+						_preload_parse_header(item, s->buf, res);
+					s->offset += res;
+					item->size += res;
+					if (res == PRELOAD_BLOCK_SIZE && !unsupported) {
+						_preload_ring_read(&ring, cqe->user_data, s);
+						continue;
+					}
+				}
+			}
+
+			if (s->fd != -1)
+				close(s->fd);
+			s->fd = -1;
+			s->state = SLOT_FREE;
+			_preload_stamp(item, start);
+			inflight--;
+		}
+		__sync_synchronize();	/* entries consumed before the head */
+		*ring.cq_head = head;
+	}
+
+	/* io_uring_enter() failed with files still open */
+	for (i = 0; i < PRELOAD_DEPTH; i++) {
+		if (slot[i].fd != -1)
+			close(slot[i].fd);
+	}
+	free(bufs);
+	_preload_ring_fini(&ring);
+
+	if (unsupported) {
+		debug_msg("io_uring does not support openat/read on this kernel\n");
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+	}
+	return ret;
+}
+
+#endif /* USE_IO_URING */
+
+int MMSoundMgrPreload(mm_sound_preload_item_t *items, int count, mm_sound_preload_result_t *result)
+{
+	struct timespec start, end;
+	int ret = MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+	int i;
+
+	if (items == NULL || result == NULL || count < 0)
+		return MM_ERROR_INVALID_ARGUMENT;
+
+	memset(result, 0, sizeof(mm_sound_preload_result_t));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+#ifdef USE_IO_URING
+	ret = _preload_io_uring(items, count, &start);
+	if (ret == MM_ERROR_NONE)
+		result->engine = MM_SOUND_PRELOAD_ENGINE_IO_URING;
+#endif
+	if (ret != MM_ERROR_NONE) {
+		/* Start over, nothing of a failed ring run is kept */
+		for (i = 0; i < count; i++) {
+			const char *filename = items[i].filename;
+			memset(&items[i], 0, sizeof(mm_sound_preload_item_t));
+			items[i].filename = filename;
+		}
+		result->engine = MM_SOUND_PRELOAD_ENGINE_THREAD_POOL;
+		ret = _preload_thread_pool(items, count, &start);
+	}
+
+	for (i = 0; i < count; i++)
+		_preload_done(&items[i], result);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	result->elapsed_us = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+
+	debug_msg("Preloaded %d files (%d failed), %llu bytes in %ld us, %llu KB/s with %s\n",
+			result->loaded, result->failed, result->bytes, result->elapsed_us,
+			result->elapsed_us ? result->bytes * 1000000ULL / 1024 / result->elapsed_us : 0ULL,
+			result->engine == MM_SOUND_PRELOAD_ENGINE_IO_URING ? "io_uring" : "thread pool");
+
+	return ret;
+}
@@ -20,6 +20,7 @@
  */
  
 #include <stdio.h>
+#include <string.h>
 
 #include "include/mm_sound_plugin_run.h"
 #include "include/mm_sound_mgr_run.h"
@@ -82,6 +83,7 @@ int MMSoundMgrRunStopAll(void)
 
 	while (g_run_plugins[loop].type != MM_SOUND_PLUGIN_TYPE_NONE) {
 		debug_msg("loop : %d\n", loop);	
+		memset(&intface, 0, sizeof(mmsound_run_interface_t));
 		MMSoundPluginGetSymbol(&g_run_plugins[loop], RUN_GET_INTERFACE_FUNC_NAME, &func);
 		MMSoundPlugRunCastGetInterface(func)(&intface);
 		intface.stop();
@@ -92,6 +94,35 @@ int MMSoundMgrRunStopAll(void)
     return MM_ERROR_NONE;
 }
 
+int MMSoundMgrRunControl(int op, void *arg)
+{
+	mmsound_run_interface_t intface;
+	void *func = NULL;
+	int loop = 0;
+	int err = MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+
+	debug_fenter();
+
+	if (g_run_plugins == NULL)
+		return MM_ERROR_SOUND_INTERNAL;
+
+	/* First plugin which knows the op handles it */
+	while (g_run_plugins[loop].type != MM_SOUND_PLUGIN_TYPE_NONE) {
+		memset(&intface, 0, sizeof(mmsound_run_interface_t));
+		if (MMSoundPluginGetSymbol(&g_run_plugins[loop], RUN_GET_INTERFACE_FUNC_NAME, &func) == MM_ERROR_NONE &&
+			MMSoundPlugRunCastGetInterface(func)(&intface) == MM_ERROR_NONE &&
+			intface.control) {
+			err = intface.control(op, arg);
+			if (err != MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE)
+				break;
+		}
+		loop++;
+	}
+
+	debug_fleave();
+	return err;
+}
+
 static void _MMsoundMgrRunRunInternal(void *param)
 {
 	int err = MM_ERROR_NONE;
@@ -100,6 +131,8 @@ static void _MMsoundMgrRunRunInternal(void *param)
 
 	debug_enter("plugin number %d\n", (int)param);
 
+	memset(&intface, 0, sizeof(mmsound_run_interface_t));
+
 	err = MMSoundPluginGetSymbol(&g_run_plugins[(int)param], RUN_GET_INTERFACE_FUNC_NAME, &func);
 	if (err  != MM_ERROR_NONE) {
 		debug_error("Get Symbol RUN_GET_INTERFACE_FUNC_NAME is fail : %x\n", err);
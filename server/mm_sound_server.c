@@ -34,6 +34,7 @@
 #include <mm_debug.h>
 #include "include/mm_sound_thread_pool.h"
 #include "include/mm_sound_mgr_run.h"
+#include "include/mm_sound_mgr_cache.h"
 #include "include/mm_sound_mgr_codec.h"
 #include "include/mm_sound_mgr_ipc.h"
 #include "include/mm_sound_mgr_pulse.h"
@@ -202,6 +203,7 @@ int main(int argc, char **argv)
 
 	if (serveropt.startserver || serveropt.printlist) {
 		MMSoundThreadPoolInit();
+		MMSoundMgrCacheInit();
 		MMSoundMgrRunInit(serveropt.plugdir);
 		MMSoundMgrCodecInit(serveropt.plugdir);
 		if (!serveropt.testmode)
@@ -235,6 +237,7 @@ int main(int argc, char **argv)
 
 		MMSoundMgrCodecFini();
 		MMSoundMgrRunFini();
+		MMSoundMgrCacheFini();
 		MMSoundThreadPoolFini();
 
 		MMSoundMgrDockFini();
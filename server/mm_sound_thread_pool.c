@@ -27,6 +27,7 @@
 #include <mm_error.h>
 #include <mm_debug.h>
 #include <mm_sound_thread_pool.h>
+#include <mm_sound_pool.h>
 
 #define USE_G_THREAD_POOL
 #ifdef USE_G_THREAD_POOL
@@ -41,6 +42,10 @@ typedef struct __THREAD_INFO
 	void *param;
 } THREAD_INFO;
 
+/* Tasks queued or running, more than this many come from malloc() */
+#define THREAD_INFO_POOL_COUNT	32
+static mm_sound_pool_t g_info_pool = MM_SOUND_POOL_INITIALIZER("thread info", sizeof(THREAD_INFO), THREAD_INFO_POOL_COUNT);
+
 static void __DummyWork (void* param)
 {
 	debug_msg ("thread index = %d\n", (int)param);
@@ -61,7 +66,7 @@ static void __ThreadWork(gpointer data, gpointer user_data)
 		 /* Info was allocated by MMSoundThreadPoolRun(). 
 			The actual content of info should be  freed whether inside func or outside (if handle) */
 		 debug_msg ("free [%p]\n", info);
-		 free (info);
+		 mm_sound_pool_free (&g_info_pool, info);
 		 info = NULL;
 	} else {
 		debug_warning ("No valid thread info...Nothing to do...\n");
@@ -84,6 +89,7 @@ int MMSoundThreadPoolDump(int fulldump)
 	debug_msg ("***** [ThreadPool] running=[%d], unused=[%d]\n",
 			g_thread_pool_get_num_threads (g_pool),
 			g_thread_pool_get_num_unused_threads() );
+	mm_sound_pool_dump();
 
 	return MM_ERROR_NONE;
 }
@@ -130,7 +136,7 @@ int MMSoundThreadPoolRun(void *param, void (*func)(void*))
 
 	/* Create thread info structure. 
 	   This thread info data will be free in __ThreadWork(), after use. */
-	THREAD_INFO* thread_info = (THREAD_INFO*)malloc (sizeof(THREAD_INFO));
+	THREAD_INFO* thread_info = (THREAD_INFO*)mm_sound_pool_alloc (&g_info_pool, sizeof(THREAD_INFO));
 	if (thread_info) {
 		thread_info->func = func;
 		thread_info->param = param;
@@ -141,6 +147,7 @@ int MMSoundThreadPoolRun(void *param, void (*func)(void*))
 		if (error) {
 			debug_error ("g_thread_pool_push failed : %s\n", error->message);
 			g_error_free (error);
+			mm_sound_pool_free (&g_info_pool, thread_info);
 			return MM_ERROR_SOUND_INTERNAL;
 		}
 	} else {
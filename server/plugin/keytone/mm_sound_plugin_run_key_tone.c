@@ -35,6 +35,10 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <stdint.h>
 #include <errno.h>
 #include <semaphore.h>
 
@@ -43,79 +47,365 @@
 
 #include "../../include/mm_sound_plugin_run.h"
 #include "../../include/mm_sound_plugin_codec.h"
+#include "../../../include/mm_sound_keytone.h"
 
-#define TIMEOUT_SEC 2
-#define MAX_BUFFER_SIZE 1920
-#define KEYTONE_PATH "/tmp/keytone"		/* Keytone pipe path */
+/*
+ * Keep-alive of the idle audio handle follows the press rate : presses every
+ * KEYTONE_ACTIVE_INTERVAL_MS or faster keep it for KEYTONE_KEEPALIVE_MAX_MS,
+ * slower typing shortens it in proportion down to KEYTONE_KEEPALIVE_MIN_MS.
+ */
+#define KEYTONE_ACTIVE_INTERVAL_MS	500
+#define KEYTONE_KEEPALIVE_MIN_MS	500
+#define KEYTONE_KEEPALIVE_MAX_MS	10000
+#define KEYTONE_INTERVAL_INIT_MS	2500	/* 2 sec keep-alive until presses are seen */
+#define KEYTONE_INTERVAL_CAP_MS		60000
+#define KEYTONE_READ_SIZE 4096			/* PIPE_BUF, drained at once per wakeup */
+#define KEYTONE_VOICE_MAX 4				/* Overlapping keytones mixed at once, per channel */
+#define KEYTONE_CHANNEL_MAX 4			/* Volume types with their own audio handle at once */
+#define KEYTONE_QUEUE_SIZE 16			/* Pending presses, power of 2 */
+/*
+ * Flood limit : a press coming sooner than KEYTONE_MIN_INTERVAL_MS after the
+ * last played one is dropped, or with the merge policy held back and replaced
+ * by later ones, so only the last press of a burst is played once the interval
+ * is over. A stuck key or a script on the pipe then costs at most one open and
+ * parse per interval. Both can be overridden by the environment.
+ */
+#define KEYTONE_MIN_INTERVAL_MS		20
+#define KEYTONE_MIN_INTERVAL_ENV	"MM_SOUND_KEYTONE_MIN_INTERVAL"	/* msec, 0 disables the limit */
+#define KEYTONE_FLOOD_POLICY_ENV	"MM_SOUND_KEYTONE_FLOOD_POLICY"	/* "drop" or "merge" */
+#define KEYTONE_MIN_INTERVAL_MAX_MS	1000
 #define KEYTONE_GROUP	6526			/* Keytone group : assigned by security */
-#define FILE_FULL_PATH 1024				/* File path lenth */
 #define AUDIO_CHANNEL 1
 #define AUDIO_SAMPLERATE 44100
 
 
 enum {
-	WAVE_CODE_UNKNOWN		= 0,
-	WAVE_CODE_PCM			= 1,
-	WAVE_CODE_ADPCM			= 2,
-	WAVE_CODE_G711			= 3,
-	WAVE_CODE_IMA_ADPCM		= 17,
-	WAVE_CODE_G723_ADPCM		= 20,
-	WAVE_CODE_GSM			= 49,
-	WAVE_CODE_G721_ADPCM		= 64,
-	WAVE_CODE_MPEG			= 80,
+	KEYTONE_FLOOD_MERGE,			/* keep the last press of a burst, play it when the interval is over */
+	KEYTONE_FLOOD_DROP,				/* drop presses inside the interval */
 };
 
-#define MAKE_FOURCC(a, b, c, d)		((a) | (b) << 8) | ((c) << 16 | ((d) << 24))
-#define RIFF_CHUNK_ID				((unsigned long) MAKE_FOURCC('R', 'I', 'F', 'F'))
-#define RIFF_CHUNK_TYPE				((unsigned long) MAKE_FOURCC('W', 'A', 'V', 'E'))
-#define FMT_CHUNK_ID				((unsigned long) MAKE_FOURCC('f', 'm', 't', ' '))
-#define DATA_CHUNK_ID				((unsigned long) MAKE_FOURCC('d', 'a', 't', 'a'))
-
 enum {
 	RENDER_READY,
-	RENDER_START,
-	RENDER_STARTED,
-	RENDER_STOP,
-	RENDER_STOPED,
-	RENDER_STOPED_N_WAIT,
-	RENDER_COND_TIMED_WAIT,
+	RENDER_STARTED,					/* Mixing voices */
+	RENDER_STOPED_N_WAIT,			/* Idle, handle closed */
+	RENDER_COND_TIMED_WAIT,			/* Idle, handle kept open until timeout */
 };
 
 typedef struct
 {
-	pthread_mutex_t sw_lock;
-	pthread_cond_t sw_cond;
-	avsys_handle_t handle;
+	int wake_fd;					/* eventfd, wakes the idle render thread */
+	volatile int state;				/* RENDER_XXX, changed with __sync builtins */
+} keytone_info_t;
 
-	int period;
+typedef mm_sound_keytone_ipc_t ipc_type;
+
+/* Per press trace points, CLOCK_MONOTONIC */
+enum {
+	KEYTONE_TRACE_SENT,				/* client write */
+	KEYTONE_TRACE_READ,				/* pipe read */
+	KEYTONE_TRACE_OPEN,				/* source opened or found in the bank */
+	KEYTONE_TRACE_PARSE,			/* source parsed */
+	KEYTONE_TRACE_HANDLE,			/* render thread took it with a ready handle */
+	KEYTONE_TRACE_WRITE,			/* first period written */
+	KEYTONE_TRACE_MAX,
+};
+
+/* A press handed from the pipe reader to the render thread */
+typedef struct
+{
+	MMSourceType source;
+	mmsound_codec_info_t info;
+	int banked;						/* source belongs to the bank, render must not close it */
 	int vol_type;
-	int state;
-	void *src;
-} keytone_info_t;
+	struct timespec trace[KEYTONE_TRACE_MAX];
+} keytone_press_t;
 
+/* A playing keytone, owned by the render thread */
 typedef struct
 {
-	char filename[FILE_FULL_PATH];
+	keytone_press_t press;
+	const short *pos;
+	unsigned int left;				/* bytes */
+	unsigned int seq;				/* start order, the lowest is stolen first */
+	int active;
+	int first;
+	int cold;						/* this press opened the audio handle */
+} keytone_voice_t;
+
+/*
+ * One audio handle per volume type and PCM format, so presses of another type
+ * neither reuse a handle routed for the wrong type nor close a warm one, and
+ * every voice mixed in a handle has its format. All channels are owned and
+ * rendered by the render thread.
+ */
+typedef struct
+{
+	int used;						/* bound to vol_type, channels and samplerate */
 	int vol_type;
-}ipc_type;
+	avsys_handle_t handle;
+	int created;					/* handle is open */
+	int period;
+	int channels;					/* format of the handle, every voice mixed in has it */
+	int samplerate;
+
+	keytone_voice_t voice[KEYTONE_VOICE_MAX];
+	int active;						/* voices playing */
+	int flush;						/* last voice ended, tail not pushed out of the device yet */
+	unsigned int seq;				/* start order, the lowest voice is stolen first */
 
+	struct timespec last_press;
+	unsigned int interval_ms;		/* averaged press interval, sets the keep-alive */
+	struct timespec idle_since;		/* keep-alive starts when the tail is pushed out */
+} keytone_channel_t;
+
+/* Registered keytones : opened, parsed and paged in once, never released */
 typedef struct
 {
-	mmsound_codec_info_t *info;
-	MMSourceType *source;
-} buf_param_t;
+	char filename[FILE_FULL_PATH];
+	MMSourceType source;
+	mmsound_codec_info_t info;
+} keytone_bank_entry_t;
+
+static keytone_bank_entry_t g_bank[KEYTONE_BANK_MAX];
+static int g_bank_count = 0;
+static pthread_mutex_t g_bank_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static int (*g_thread_pool_func)(void*, void (*)(void*)) = NULL;
 
-int CreateAudioHandle();
-static int g_CreatedFlag;
+int CreateAudioHandle(keytone_channel_t *channel, mmsound_codec_info_t info);
 static int __MMSoundKeytoneParse(MMSourceType *source, mmsound_codec_info_t *info);
 static int _MMSoundKeytoneInit(void);
 static int _MMSoundKeytoneFini(void);
 static int _MMSoundKeytoneRender(void *param_not_used);
-static unsigned int _MMSoundKeytoneTimeOut();
+static int _MMSoundKeytoneBankRegister(const char *filename, int *keytone_id);
+static int _MMSoundKeytoneBankGet(int keytone_id, const char *filename, MMSourceType *source, mmsound_codec_info_t *info);
 static keytone_info_t g_keytone;
-static int stop_flag = 0;
+static volatile int stop_flag = 0;
+
+/* Updated by the render thread and the pipe reader, read by GET_STATS : all under g_stats_lock */
+static mm_sound_keytone_stats_t g_stats = {0,};
+static pthread_mutex_t g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static keytone_channel_t g_channel[KEYTONE_CHANNEL_MAX];
+
+/* Period sized work buffers, grown when the device reports a bigger period */
+static short *g_outbuf = NULL;		/* mixed or partial period */
+static int *g_mixbuf = NULL;		/* mix accumulator */
+static char *g_zerobuf = NULL;		/* shared silence for padding */
+static int g_buf_size = 0;
+
+/*
+ * Single producer (pipe reader), single consumer (render thread) press queue.
+ * head is only written by the reader, tail only by the render thread.
+ */
+static keytone_press_t g_queue[KEYTONE_QUEUE_SIZE];
+static volatile unsigned int g_queue_head = 0;
+static volatile unsigned int g_queue_tail = 0;
+
+static int __MMSoundKeytonePush(const keytone_press_t *press)
+{
+	unsigned int head = g_queue_head;
+
+	if (head - g_queue_tail >= KEYTONE_QUEUE_SIZE)
+		return MM_ERROR_SOUND_NO_FREE_SPACE;
+
+	g_queue[head % KEYTONE_QUEUE_SIZE] = *press;
+	__sync_synchronize();	/* publish the entry before the index */
+	g_queue_head = head + 1;
+	return MM_ERROR_NONE;
+}
+
+static int __MMSoundKeytonePop(keytone_press_t *press)
+{
+	unsigned int tail = g_queue_tail;
+
+	if (tail == g_queue_head)
+		return MMSOUND_FALSE;
+
+	__sync_synchronize();	/* read the entry after the index */
+	*press = g_queue[tail % KEYTONE_QUEUE_SIZE];
+	__sync_synchronize();	/* done with the entry before giving the slot back */
+	g_queue_tail = tail + 1;
+	return MMSOUND_TRUE;
+}
+
+/*
+ * Reader side : a syscall only when the render thread sleeps. Whoever moves
+ * the state out of the idle value sends the wakeup, so it is sent once.
+ */
+static void __MMSoundKeytoneWake(void)
+{
+	uint64_t one = 1;
+	int state;
+
+	__sync_synchronize();	/* queue index before state, pairs with __MMSoundKeytoneIdle() */
+	state = g_keytone.state;
+	if ((state == RENDER_STOPED_N_WAIT || state == RENDER_COND_TIMED_WAIT) &&
+		__sync_bool_compare_and_swap(&g_keytone.state, state, RENDER_STARTED)) {
+		if (write(g_keytone.wake_fd, &one, sizeof(one)) != sizeof(one))
+			debug_error("Fail to wake render thread. errno=[%d]\n", errno);
+	}
+}
+
+/* Pipe bytes read but not yet parsed, from g_read_pos : records left by the last read, then a cut one */
+static char g_read_buf[KEYTONE_READ_SIZE];
+static int g_read_len = 0;
+static int g_read_pos = 0;
+
+/* Flood limit, pipe reader only */
+static int g_flood_policy = KEYTONE_FLOOD_MERGE;
+static long g_min_interval_us = KEYTONE_MIN_INTERVAL_MS * 1000;
+static struct timespec g_last_played = {0, 0};
+
+/* Reads everything pending on the pipe after the bytes kept. Returns the bytes read, -1 on error. */
+static int __MMSoundKeytoneRead(int fd)
+{
+	int len;
+
+	if (g_read_pos) {
+		g_read_len -= g_read_pos;
+		memmove(g_read_buf, g_read_buf + g_read_pos, g_read_len);
+		g_read_pos = 0;
+	}
+
+	len = read(fd, g_read_buf + g_read_len, sizeof(g_read_buf) - g_read_len);
+	if (len <= 0)
+		return -1;
+	g_read_len += len;
+
+	return len;
+}
+
+/*
+ * Takes the next complete press of the buffer. Every press of a read is
+ * played on its own voice, bursts are left to the flood limit.
+ * Returns 1 for a press, 0 when only a partial record or nothing is left.
+ */
+static int __MMSoundKeytoneNext(ipc_type *press, char *filename)
+{
+	ipc_type rec;
+
+	if (g_read_len - g_read_pos < (int)sizeof(ipc_type))
+		return 0;
+
+	memcpy(&rec, g_read_buf + g_read_pos, sizeof(ipc_type));
+	if (rec.version != KEYTONE_IPC_VERSION || rec.length >= FILE_FULL_PATH ||
+		(!(rec.flags & KEYTONE_FLAG_PATH) && rec.length)) {
+		/* Can not find the next record boundary, drop what is buffered */
+		debug_error("Invalid keytone record (version %d, length %d), drop %d bytes\n",
+				rec.version, rec.length, g_read_len - g_read_pos);
+		g_read_pos = g_read_len;
+		return 0;
+	}
+	if (g_read_len - g_read_pos < (int)sizeof(ipc_type) + rec.length)
+		return 0;
+
+	*press = rec;
+	memcpy(filename, g_read_buf + g_read_pos + sizeof(ipc_type), rec.length);
+	filename[rec.length] = '\0';
+	g_read_pos += sizeof(ipc_type) + rec.length;
+
+	return 1;
+}
+
+static void __MMSoundKeytoneFloodInit(void)
+{
+	const char *env;
+	int ms;
+
+	env = getenv(KEYTONE_MIN_INTERVAL_ENV);
+	if (env) {
+		ms = atoi(env);
+		if (ms < 0)
+			ms = 0;
+		else if (ms > KEYTONE_MIN_INTERVAL_MAX_MS)
+			ms = KEYTONE_MIN_INTERVAL_MAX_MS;
+		g_min_interval_us = ms * 1000L;
+	}
+
+	env = getenv(KEYTONE_FLOOD_POLICY_ENV);
+	if (env && strcmp(env, "drop") == 0)
+		g_flood_policy = KEYTONE_FLOOD_DROP;
+	else
+		g_flood_policy = KEYTONE_FLOOD_MERGE;
+
+	debug_msg("[%s] min interval %ld ms, %s policy\n", __func__, g_min_interval_us / 1000,
+			g_flood_policy == KEYTONE_FLOOD_DROP ? "drop" : "merge");
+}
+
+/* Microseconds left until a press may be played, 0 if it may be played now */
+static long __MMSoundKeytoneFloodWait(const struct timespec *now)
+{
+	long elapsed;
+
+	if (g_min_interval_us == 0 || (g_last_played.tv_sec == 0 && g_last_played.tv_nsec == 0))
+		return 0;
+
+	elapsed = (now->tv_sec - g_last_played.tv_sec) * 1000000L +
+			(now->tv_nsec - g_last_played.tv_nsec) / 1000;
+	if (elapsed < 0 || elapsed >= g_min_interval_us)
+		return 0;
+
+	return g_min_interval_us - elapsed;
+}
+
+/* Opens (or takes from the bank) and parses a press, then hands it to the render thread */
+static void __MMSoundKeytoneDispatch(const ipc_type *data, const char *filename, const struct timespec *read_time)
+{
+	keytone_press_t press;
+	static int once = MMSOUND_TRUE;
+	int ret;
+
+	memset(&press, 0, sizeof(keytone_press_t));
+	press.trace[KEYTONE_TRACE_SENT].tv_sec = data->sent_sec;
+	press.trace[KEYTONE_TRACE_SENT].tv_nsec = data->sent_nsec;
+	press.trace[KEYTONE_TRACE_READ] = *read_time;
+	press.vol_type = data->vol_type;
+	debug_log("[%s] The volume type is [%d]\n", __func__, press.vol_type);
+
+	/* Registered keytones skip open and parse, by ID or by path */
+	ret = _MMSoundKeytoneBankGet(data->keytone_id, filename, &press.source, &press.info);
+	if (ret == MM_ERROR_NONE) {
+		press.banked = MMSOUND_TRUE;
+		clock_gettime(CLOCK_MONOTONIC, &press.trace[KEYTONE_TRACE_OPEN]);
+		press.trace[KEYTONE_TRACE_PARSE] = press.trace[KEYTONE_TRACE_OPEN];
+	} else if (data->keytone_id != KEYTONE_ID_NONE) {
+		debug_error("Keytone ID [%d] is not registered\n", data->keytone_id);
+		return;
+	} else {
+		press.banked = MMSOUND_FALSE;
+
+		ret = mm_source_open_file(filename, &press.source, MM_SOURCE_NOT_DRM_CONTENTS);
+		if (ret != MM_ERROR_NONE) {
+			debug_critical("Cannot open files\n");
+			return;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &press.trace[KEYTONE_TRACE_OPEN]);
+
+		ret = __MMSoundKeytoneParse(&press.source, &press.info);
+		if(ret != MM_ERROR_NONE || press.info.doffset + press.info.size > press.source.cur_size) {
+			debug_critical("Fail to parse file\n");
+			mm_source_close(&press.source);
+			return;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &press.trace[KEYTONE_TRACE_PARSE]);
+	}
+
+	if(once== MMSOUND_TRUE) {
+		g_thread_pool_func(NULL,  (void*)_MMSoundKeytoneRender);
+		once= MMSOUND_FALSE;
+	}
+
+	if (__MMSoundKeytonePush(&press) != MM_ERROR_NONE) {
+		debug_error("[%s] press queue is full, drop this press\n", __func__);
+		pthread_mutex_lock(&g_stats_lock);
+		g_stats.dropped++;
+		pthread_mutex_unlock(&g_stats_lock);
+		if (!press.banked)
+			mm_source_close(&press.source);
+		return;
+	}
+	__MMSoundKeytoneWake();
+}
 
 static 
 int MMSoundPlugRunKeytoneControlRun(void)
@@ -124,10 +414,16 @@ int MMSoundPlugRunKeytoneControlRun(void)
 	int ret = MM_ERROR_NONE;
 	int fd = -1;
 	ipc_type data;
-	int size = 0;
-	mmsound_codec_info_t info = {0,};
-	MMSourceType source = {0,};
-	buf_param_t buf_param = {NULL, NULL};
+	char filename[FILE_FULL_PATH];
+	struct timespec now;
+	struct pollfd pfd;
+	long wait_us;
+
+	/* Press held back by the merge policy */
+	int pending = MMSOUND_FALSE;
+	ipc_type pending_data;
+	char pending_filename[FILE_FULL_PATH];
+	struct timespec pending_read;
 
 	debug_enter("\n");
 
@@ -161,79 +457,70 @@ int MMSoundPlugRunKeytoneControlRun(void)
 		debug_critical("Cannot create keytone\n");
 
 	}
+	__MMSoundKeytoneFloodInit();
 	stop_flag = 1;
-	source.ptr = NULL;
 
 	debug_msg("[%s] Trace\n", __func__);
-	size = sizeof(ipc_type);
-	int once= MMSOUND_TRUE;
-	int flag= MMSOUND_FALSE;
-	g_CreatedFlag = MMSOUND_FALSE;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
 
 	while(stop_flag) {
-		memset(&data, 0, sizeof(ipc_type));
+		/* A held back press is played when its interval is over, unless a later one replaces it */
+		if (pending) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			wait_us = __MMSoundKeytoneFloodWait(&now);
+			if (wait_us > 0) {
+				ret = poll(&pfd, 1, (wait_us + 999) / 1000);
+				if (ret < 0 && errno != EINTR)
+					debug_error("[%s] poll failed. errno=[%d]\n", __func__, errno);
+			}
+			if (wait_us == 0 || ret == 0) {
+				clock_gettime(CLOCK_MONOTONIC, &g_last_played);
+				__MMSoundKeytoneDispatch(&pending_data, pending_filename, &pending_read);
+				pending = MMSOUND_FALSE;
+				continue;
+			}
+			if (ret < 0)
+				continue;
+		}
+
 		debug_msg("[%s] The Keytone plugin is running......\n", __func__);
-		ret = read(fd, (void *)&data, size);
+		ret = __MMSoundKeytoneRead(fd);
 		if(ret == -1) {
 			debug_error("[%s] Fail to read file\n", __func__);
 			continue;
 		}
 		debug_msg("[%s] The Keytone plugin is running......READ returns....\n", __func__);
 
-		pthread_mutex_lock(&g_keytone.sw_lock);
-		g_keytone.vol_type = data.vol_type;
-		debug_log("[%s] The volume type is [%d]\n", __func__, g_keytone.vol_type);
+		while (__MMSoundKeytoneNext(&data, filename)) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
 
-		if (g_keytone.state == RENDER_STARTED) {
-			g_keytone.state = RENDER_STOP;
-			pthread_cond_wait(&g_keytone.sw_cond, &g_keytone.sw_lock);
-		}
-		
-		ret = mm_source_open_file(data.filename, &source, MM_SOURCE_NOT_DRM_CONTENTS);
-		if (ret != MM_ERROR_NONE) {
-			debug_critical("Cannot open files\n");
-			pthread_mutex_unlock(&g_keytone.sw_lock);
-			continue;
-		}
-
-
-		ret = __MMSoundKeytoneParse(&source, &info);
-		if(ret != MM_ERROR_NONE) {
-			debug_critical("Fail to parse file\n");
-			mm_source_close(&source);
-			source.ptr = NULL;
-			pthread_mutex_unlock(&g_keytone.sw_lock);
-			continue;
-		}
-
-		if(g_CreatedFlag== MMSOUND_FALSE) {
-			if(MM_ERROR_NONE != CreateAudioHandle(info)) {
-				debug_critical("Audio handle creation failed. cannot play keytone\n");
-				mm_source_close(&source);
-				source.ptr = NULL;
-				pthread_mutex_unlock(&g_keytone.sw_lock);
-				continue;
+			if (__MMSoundKeytoneFloodWait(&now) == 0) {
+				if (pending) {
+					pthread_mutex_lock(&g_stats_lock);
+					g_stats.merged++;
+					pthread_mutex_unlock(&g_stats_lock);
+					pending = MMSOUND_FALSE;
+				}
+				g_last_played = now;
+				__MMSoundKeytoneDispatch(&data, filename, &now);
+			} else if (g_flood_policy == KEYTONE_FLOOD_MERGE) {
+				if (pending) {
+					pthread_mutex_lock(&g_stats_lock);
+					g_stats.merged++;
+					pthread_mutex_unlock(&g_stats_lock);
+				}
+				pending_data = data;
+				memcpy(pending_filename, filename, data.length + 1);
+				pending_read = now;
+				pending = MMSOUND_TRUE;
+			} else {
+				pthread_mutex_lock(&g_stats_lock);
+				g_stats.dropped++;
+				pthread_mutex_unlock(&g_stats_lock);
 			}
-			g_CreatedFlag = MMSOUND_TRUE;
-		}
-
-		buf_param.info = &info;
-		buf_param.source = &source;
-		g_keytone.src = &buf_param;
-		if(once== MMSOUND_TRUE) {
-			g_thread_pool_func(NULL,  (void*)_MMSoundKeytoneRender);
-			once= MMSOUND_FALSE;
 		}
-
-		if(g_keytone.state == RENDER_STOPED_N_WAIT ||
-				 g_keytone.state == RENDER_COND_TIMED_WAIT) {
-			pthread_cond_signal(&g_keytone.sw_cond);
-		}
-
-		debug_log ("[%s] set state to START, unlock \n", __func__);
-		g_keytone.state = RENDER_START;
-		pthread_mutex_unlock(&g_keytone.sw_lock);
-
 	}
 
 	if(fd > -1)
@@ -251,6 +538,28 @@ int MMSoundPlugRunKeytoneControlStop(void)
 	return MM_ERROR_NONE;
 }
 
+static
+int MMSoundPlugRunKeytoneControl(int op, void *arg)
+{
+	mmsound_run_keytone_register_t *reg = (mmsound_run_keytone_register_t *)arg;
+
+	switch (op) {
+	case MM_SOUND_PLUG_RUN_OP_KEYTONE_REGISTER:
+		if (reg == NULL || reg->filename == NULL)
+			return MM_ERROR_INVALID_ARGUMENT;
+		return _MMSoundKeytoneBankRegister(reg->filename, &reg->keytone_id);
+	case MM_SOUND_PLUG_RUN_OP_KEYTONE_GET_STATS:
+		if (arg == NULL)
+			return MM_ERROR_INVALID_ARGUMENT;
+		pthread_mutex_lock(&g_stats_lock);
+		memcpy(arg, &g_stats, sizeof(mm_sound_keytone_stats_t));
+		pthread_mutex_unlock(&g_stats_lock);
+		return MM_ERROR_NONE;
+	default:
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+	}
+}
+
 static
 int MMSoundPlugRunKeytoneSetThreadPool(int (*func)(void*, void (*)(void*)))
 {
@@ -267,6 +576,7 @@ int MMSoundPlugRunGetInterface(mmsound_run_interface_t *intf)
 	intf->run = MMSoundPlugRunKeytoneControlRun;
 	intf->stop = MMSoundPlugRunKeytoneControlStop;
 	intf->SetThreadPool = MMSoundPlugRunKeytoneSetThreadPool;
+	intf->control = MMSoundPlugRunKeytoneControl;
 	debug_leave("\n");
 
 	return MM_ERROR_NONE;
@@ -290,12 +600,9 @@ static int _MMSoundKeytoneInit(void)
 	/* Set audio FIXED param */
 
 	g_keytone.state = RENDER_READY;
-	if(pthread_mutex_init(&(g_keytone.sw_lock), NULL)) {
-		debug_error("pthread_mutex_init() failed [%s][%d]\n", __func__, __LINE__);
-		return MM_ERROR_SOUND_INTERNAL;
-	}
-	if(pthread_cond_init(&g_keytone.sw_cond,NULL)) {
-		debug_error("pthread_cond_init() failed [%s][%d]\n", __func__, __LINE__);
+	g_keytone.wake_fd = eventfd(0, EFD_NONBLOCK);
+	if (g_keytone.wake_fd == -1) {
+		debug_error("eventfd() failed [%s][%d] errno=[%d]\n", __func__, __LINE__, errno);
 		return MM_ERROR_SOUND_INTERNAL;
 	}
 
@@ -305,23 +612,24 @@ static int _MMSoundKeytoneInit(void)
 
 static int _MMSoundKeytoneFini(void)
 {
-	g_keytone.handle = (avsys_handle_t)-1;
-
-	if (pthread_mutex_destroy(&(g_keytone.sw_lock))) {
-		debug_error("Fail to destroy mutex\n");
-		return MM_ERROR_SOUND_INTERNAL;
+	free(g_outbuf);
+	free(g_mixbuf);
+	free(g_zerobuf);
+	g_outbuf = NULL;
+	g_mixbuf = NULL;
+	g_zerobuf = NULL;
+	g_buf_size = 0;
+
+	if (g_keytone.wake_fd != -1) {
+		close(g_keytone.wake_fd);
+		g_keytone.wake_fd = -1;
 	}
 	debug_msg("destroy\n");
 
-	if (pthread_cond_destroy(&g_keytone.sw_cond)) {
-		debug_error("Fail to destroy cond\n");
-		return MM_ERROR_SOUND_INTERNAL;
-	}
-
 	return MM_ERROR_NONE;
 }
 
-int CreateAudioHandle(mmsound_codec_info_t info)
+int CreateAudioHandle(keytone_channel_t *channel, mmsound_codec_info_t info)
 {
 	int err = MM_ERROR_NONE;
 	avsys_audio_param_t audio_param;
@@ -332,252 +640,599 @@ int CreateAudioHandle(mmsound_codec_info_t info)
 	audio_param.channels = info.channels;//AUDIO_CHANNEL;
 	audio_param.samplerate = info.samplerate;//AUDIO_SAMPLERATE;
 	audio_param.format =  AVSYS_AUDIO_FORMAT_16BIT;
-	audio_param.vol_type = g_keytone.vol_type;
+	audio_param.vol_type = channel->vol_type;
 	audio_param.priority = AVSYS_AUDIO_PRIORITY_0;
 
 
-	err = avsys_audio_open(&audio_param, &g_keytone.handle, &g_keytone.period);
+	err = avsys_audio_open(&audio_param, &channel->handle, &channel->period);
 	if (AVSYS_FAIL(err)) {
 		debug_error("Fail to audio open 0x%08X\n", err);
 		return MM_ERROR_SOUND_INTERNAL;
 	}
-	debug_log("Period size is %d bytes\n", g_keytone.period);
+	debug_log("Period size is %d bytes (volume type %d)\n", channel->period, channel->vol_type);
+	channel->channels = info.channels;
+	channel->samplerate = info.samplerate;
+
+	if (channel->period > g_buf_size) {
+		free(g_outbuf);
+		free(g_mixbuf);
+		free(g_zerobuf);
+		g_outbuf = malloc(channel->period);
+		g_mixbuf = malloc(channel->period / sizeof(short) * sizeof(int));
+		g_zerobuf = calloc(1, channel->period);
+		if (g_outbuf == NULL || g_mixbuf == NULL || g_zerobuf == NULL) {
+			debug_error("Fail to allocate period buffers (%d bytes)\n", channel->period);
+			free(g_outbuf);
+			free(g_mixbuf);
+			free(g_zerobuf);
+			g_outbuf = NULL;
+			g_mixbuf = NULL;
+			g_zerobuf = NULL;
+			g_buf_size = 0;
+			avsys_audio_close(channel->handle);
+			return MM_ERROR_OUT_OF_MEMORY;
+		}
+		g_buf_size = channel->period;
+	}
+
+	return MM_ERROR_NONE;
+
+}
+
+static void __MMSoundKeytoneVoiceRelease(keytone_voice_t *voice)
+{
+	if (!voice->press.banked)
+		mm_source_close(&voice->press.source);
+	voice->active = MMSOUND_FALSE;
+}
 
+static unsigned int __MMSoundKeytoneKeepAlive(const keytone_channel_t *channel)
+{
+	unsigned int interval = channel->interval_ms;
+	unsigned int keep;
+
+	if (interval < KEYTONE_ACTIVE_INTERVAL_MS)
+		interval = KEYTONE_ACTIVE_INTERVAL_MS;
+	keep = KEYTONE_KEEPALIVE_MAX_MS * KEYTONE_ACTIVE_INTERVAL_MS / interval;
+	if (keep < KEYTONE_KEEPALIVE_MIN_MS)
+		keep = KEYTONE_KEEPALIVE_MIN_MS;
 
-	//FIXME :: remove dasf buffer size
-	if(g_keytone.period>MAX_BUFFER_SIZE) {
-		g_keytone.period = MAX_BUFFER_SIZE;
+	return keep;
+}
+
+/* Moving average (1/4 weight) of the time between presses of a channel */
+static void __MMSoundKeytoneUpdateRate(keytone_channel_t *channel, const struct timespec *press)
+{
+	long long ms;
+
+	if (channel->last_press.tv_sec || channel->last_press.tv_nsec) {
+		ms = (press->tv_sec - channel->last_press.tv_sec) * 1000LL + (press->tv_nsec - channel->last_press.tv_nsec) / 1000000LL;
+		if (ms < 0)
+			ms = 0;
+		if (ms > KEYTONE_INTERVAL_CAP_MS)
+			ms = KEYTONE_INTERVAL_CAP_MS;
+		channel->interval_ms = (int)channel->interval_ms + ((int)ms - (int)channel->interval_ms) / 4;
 	}
+	channel->last_press = *press;
+
+	/* Reported for the last pressed channel */
+	pthread_mutex_lock(&g_stats_lock);
+	g_stats.presses++;
+	g_stats.interval_ms = channel->interval_ms;
+	g_stats.keepalive_ms = __MMSoundKeytoneKeepAlive(channel);
+	pthread_mutex_unlock(&g_stats_lock);
+}
 
-	return err;
+static long __MMSoundKeytoneSpan(const struct timespec *from, const struct timespec *to)
+{
+	long us = (to->tv_sec - from->tv_sec) * 1000000L + (to->tv_nsec - from->tv_nsec) / 1000L;
 
+	return (us < 0) ? 0 : us;
 }
 
-static int _MMSoundKeytoneRender(void *param_not_used)
+/* Called with g_stats_lock held */
+static void __MMSoundKeytoneHistogram(int span, long us)
 {
-	//static int IsAmpON = MMSOUND_FALSE; //FIXME :: this should be removed
-	MMSourceType source = {0,};
-	mmsound_codec_info_t info = {0,};
-	unsigned char *buf = NULL, Outbuf[MAX_BUFFER_SIZE];
-	unsigned int size=0;
-	buf_param_t *param=NULL;
-	struct timespec timeout;
-	struct timeval tv;
-	int stat;
+	int bucket = 0;
 
+	while (bucket < MM_SOUND_KEYTONE_HIST_BUCKETS - 1 && (us >> (bucket + 1)))
+		bucket++;
+	g_stats.histogram[span][bucket]++;
+}
 
-//	unsigned int timeout_msec = _MMSoundKeytoneTimeOut();
-	while(stop_flag) {
-		pthread_mutex_lock(&g_keytone.sw_lock);
-		if(g_keytone.state == RENDER_STOPED) {
-			debug_log ("[%s] set state to STOPPED_N_WAIT and do cond wait\n", __func__);
-			g_keytone.state = RENDER_STOPED_N_WAIT;
-			pthread_cond_wait(&g_keytone.sw_cond, &g_keytone.sw_lock);
-		}
+static void __MMSoundKeytoneLatency(keytone_voice_t *voice)
+{
+	struct timespec *trace = voice->press.trace;
+	long span[MM_SOUND_KEYTONE_SPAN_MAX];
+	long us;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &trace[KEYTONE_TRACE_WRITE]);
+
+	/* Spans follow the trace points, TOTAL is from the client write */
+	for (i = 0; i < MM_SOUND_KEYTONE_SPAN_TOTAL; i++)
+		span[i] = __MMSoundKeytoneSpan(&trace[i], &trace[i + 1]);
+	span[MM_SOUND_KEYTONE_SPAN_TOTAL] = __MMSoundKeytoneSpan(&trace[KEYTONE_TRACE_SENT], &trace[KEYTONE_TRACE_WRITE]);
+	us = __MMSoundKeytoneSpan(&trace[KEYTONE_TRACE_READ], &trace[KEYTONE_TRACE_WRITE]);
+
+	pthread_mutex_lock(&g_stats_lock);
+	for (i = 0; i < MM_SOUND_KEYTONE_SPAN_MAX; i++)
+		__MMSoundKeytoneHistogram(i, span[i]);
+
+	if (voice->cold) {
+		g_stats.cold_count++;
+		g_stats.cold_total_us += us;
+		if (us > g_stats.cold_max_us)
+			g_stats.cold_max_us = us;
+	} else {
+		g_stats.warm_count++;
+		g_stats.warm_total_us += us;
+		if (us > g_stats.warm_max_us)
+			g_stats.warm_max_us = us;
+	}
+	pthread_mutex_unlock(&g_stats_lock);
 
-		if(g_keytone.state == RENDER_START) {
-			//IsAmpON = MMSOUND_TRUE;
+	debug_msg("[%s] press to first period : %ld us (%s, %s) pipe %ld, open %ld, parse %ld, handle %ld, write %ld\n",
+			__func__, span[MM_SOUND_KEYTONE_SPAN_TOTAL], voice->press.banked ? "bank" : "file", voice->cold ? "cold" : "warm",
+			span[MM_SOUND_KEYTONE_SPAN_PIPE], span[MM_SOUND_KEYTONE_SPAN_OPEN], span[MM_SOUND_KEYTONE_SPAN_PARSE],
+			span[MM_SOUND_KEYTONE_SPAN_HANDLE], span[MM_SOUND_KEYTONE_SPAN_WRITE]);
+}
 
-			debug_log ("[%s] state is START\n", __func__);
-			param = (buf_param_t *)g_keytone.src;
+static void __MMSoundKeytoneChannelClose(keytone_channel_t *channel)
+{
+	int i;
 
-			source = *param->source; /* Copy source */
-			info = *param->info;
-			buf = source.ptr+info.doffset;
+	for (i = 0; i < KEYTONE_VOICE_MAX; i++) {
+		if (channel->voice[i].active)
+			__MMSoundKeytoneVoiceRelease(&channel->voice[i]);
+	}
+	channel->active = 0;
+	channel->flush = MMSOUND_FALSE;
 
-			size = info.size;
-			if(buf==NULL) {
-				size=0;
-				debug_critical("Ooops.... Not Expected!!!!!!!!\n");
-			}
+	if (channel->created) {
+		if(AVSYS_FAIL(avsys_audio_close(channel->handle)))	{
+			debug_critical("avsys_audio_close() failed !!!!!!!!\n");
+		}
+		channel->created = MMSOUND_FALSE;
+		pthread_mutex_lock(&g_stats_lock);
+		g_stats.closes++;
+		pthread_mutex_unlock(&g_stats_lock);
+	}
+}
+
+/*
+ * Channel of 'vol_type' in the format of 'info' : its own, a free one, or the
+ * least recently pressed idle one, which is closed and rebound. NULL when
+ * every channel is playing.
+ */
+static keytone_channel_t *__MMSoundKeytoneChannel(int vol_type, const mmsound_codec_info_t *info)
+{
+	keytone_channel_t *channel = NULL;
+	keytone_channel_t *c;
+	int i;
+
+	for (i = 0; i < KEYTONE_CHANNEL_MAX; i++) {
+		c = &g_channel[i];
+		if (c->used && c->vol_type == vol_type && c->channels == info->channels && c->samplerate == info->samplerate)
+			return c;
+		if (!c->used && channel == NULL)
+			channel = c;
+	}
 
-			g_keytone.state = RENDER_STARTED;
+	if (channel == NULL) {
+		for (i = 0; i < KEYTONE_CHANNEL_MAX; i++) {
+			c = &g_channel[i];
+			if (c->active)
+				continue;
+			if (channel == NULL || c->last_press.tv_sec < channel->last_press.tv_sec ||
+				(c->last_press.tv_sec == channel->last_press.tv_sec && c->last_press.tv_nsec < channel->last_press.tv_nsec))
+				channel = c;
 		}
+		if (channel == NULL)
+			return NULL;
+		debug_msg("[%s] rebind channel %d from volume type %d (%d ch %d Hz) to %d (%d ch %d Hz)\n", __func__,
+				(int)(channel - g_channel), channel->vol_type, channel->channels, channel->samplerate,
+				vol_type, info->channels, info->samplerate);
+		__MMSoundKeytoneChannelClose(channel);
+	}
 
-		pthread_mutex_unlock(&g_keytone.sw_lock);
+	memset(channel, 0, sizeof(keytone_channel_t));
+	channel->used = MMSOUND_TRUE;
+	channel->vol_type = vol_type;
+	channel->channels = info->channels;
+	channel->samplerate = info->samplerate;
+	channel->interval_ms = KEYTONE_INTERVAL_INIT_MS;
 
+	return channel;
+}
 
+/* Move queued presses to voices of their channel, stealing the oldest voice when all are busy */
+static void __MMSoundKeytoneTakePresses(void)
+{
+	keytone_press_t press;
+	keytone_channel_t *channel;
+	keytone_voice_t *voice;
+	keytone_voice_t *v = NULL;
+	int cold;
+	int i;
+
+	while (__MMSoundKeytonePop(&press)) {
+		channel = __MMSoundKeytoneChannel(press.vol_type, &press.info);
+		if (channel == NULL) {
+			debug_error("[%s] no keytone channel for volume type %d, drop this press\n", __func__, press.vol_type);
+			if (!press.banked)
+				mm_source_close(&press.source);
+			continue;
+		}
+		__MMSoundKeytoneUpdateRate(channel, &press.trace[KEYTONE_TRACE_READ]);
 
+		cold = MMSOUND_FALSE;
+		if (channel->created == MMSOUND_FALSE) {
+			if (MM_ERROR_NONE != CreateAudioHandle(channel, press.info)) {
+				debug_critical("Audio handle creation failed. cannot play keytone\n");
+				if (!press.banked)
+					mm_source_close(&press.source);
+				continue;
+			}
+			channel->created = MMSOUND_TRUE;
+			pthread_mutex_lock(&g_stats_lock);
+			g_stats.opens++;
+			pthread_mutex_unlock(&g_stats_lock);
+			cold = MMSOUND_TRUE;
+		} else if (press.info.channels != channel->channels || press.info.samplerate != channel->samplerate) {
+			/* channels are bound to a format, this is not expected to happen */
+			debug_warning("[%s] %d ch %d Hz keytone does not match the %d ch %d Hz handle, drop this press\n", __func__,
+					press.info.channels, press.info.samplerate, channel->channels, channel->samplerate);
+			if (!press.banked)
+				mm_source_close(&press.source);
+			continue;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &press.trace[KEYTONE_TRACE_HANDLE]);
 
-		while(size && stop_flag) {
-			pthread_mutex_lock(&g_keytone.sw_lock);
-			if (g_keytone.state == RENDER_STOP) {
-				debug_log ("[%s] state is STOP\n", __func__);
-				pthread_mutex_unlock(&g_keytone.sw_lock);
+		voice = channel->voice;
+		v = NULL;
+		for (i = 0; i < KEYTONE_VOICE_MAX; i++) {
+			if (!voice[i].active) {
+				v = &voice[i];
 				break;
 			}
-			pthread_mutex_unlock(&g_keytone.sw_lock);				
-
-			if(size<g_keytone.period) {
-#if defined(_DEBUG_VERBOS_)
-				debug_msg("[%s][Keysound] Last Buffer :: size=%d, period=%d\n", __func__, size, g_keytone.period);
-#endif
-				memset(Outbuf, 0, g_keytone.period);
-				memcpy(Outbuf, buf, size);
-				avsys_audio_write(g_keytone.handle, (void *)Outbuf, g_keytone.period);
-								
-				memset(Outbuf, 0, g_keytone.period);
-				avsys_audio_write(g_keytone.handle, (void *)Outbuf, g_keytone.period);
-				avsys_audio_write(g_keytone.handle, (void *)Outbuf, g_keytone.period);				
-				
-				size = 0;
-			} else {
-#if defined(_DEBUG_VERBOS_)
-				debug_msg("[%s][Keysound] size=%d, period=%d\n", __func__, size, g_keytone.period);
-#endif
-				memcpy(Outbuf, buf, g_keytone.period);
+			if (v == NULL || voice[i].seq < v->seq)
+				v = &voice[i];
+		}
+		if (v->active) {
+			debug_log("[%s] steal voice %d\n", __func__, (int)(v - voice));
+			__MMSoundKeytoneVoiceRelease(v);
+			channel->active--;
+		}
 
-				avsys_audio_write(g_keytone.handle, (void *)Outbuf, g_keytone.period);
-				size -= g_keytone.period;
-				buf += g_keytone.period;
+		v->press = press;
+		v->pos = (const short *)((char *)press.source.ptr + press.info.doffset);
+		v->left = press.info.size & ~1;
+		v->seq = channel->seq++;
+		v->first = MMSOUND_TRUE;
+		v->cold = cold;
+		v->active = MMSOUND_TRUE;
+		channel->active++;
+		channel->flush = MMSOUND_FALSE;
+	}
+}
 
-			}
+/* Sum one period of every voice with saturation, returns voices still playing */
+static int __MMSoundKeytoneMix(keytone_voice_t *voice, short *out, int bytes)
+{
+	int *mix = g_mixbuf;
+	int samples = bytes / sizeof(short);
+	int active = 0;
+	int i, j, n;
+
+	memset(mix, 0, samples * sizeof(int));
+
+	for (i = 0; i < KEYTONE_VOICE_MAX; i++) {
+		if (!voice[i].active)
+			continue;
+
+		n = voice[i].left / sizeof(short);
+		if (n > samples)
+			n = samples;
+		for (j = 0; j < n; j++)
+			mix[j] += voice[i].pos[j];
+		voice[i].pos += n;
+		voice[i].left -= n * sizeof(short);
+		active++;
+	}
+
+	for (j = 0; j < samples; j++) {
+		if (mix[j] > 32767)
+			out[j] = 32767;
+		else if (mix[j] < -32768)
+			out[j] = -32768;
+		else
+			out[j] = mix[j];
+	}
+
+	return active;
+}
+
+/* Write one period of a channel */
+static void __MMSoundKeytoneChannelRender(keytone_channel_t *channel)
+{
+	keytone_voice_t *voice = channel->voice;
+	keytone_voice_t *v = NULL;
+	int i;
+
+	if (channel->active == 1) {
+		for (i = 0; i < KEYTONE_VOICE_MAX; i++) {
+			if (voice[i].active)
+				v = &voice[i];
 		}
+	}
 
-		mm_source_close(&source);
-		source.ptr = NULL;
-
-		pthread_mutex_lock(&g_keytone.sw_lock);
-		if(g_keytone.state == RENDER_STOP ) {
-			debug_msg("[%s] state is STOP, do cond signal \n", __func__);
-			g_keytone.state = RENDER_STOPED;
-			pthread_cond_signal(&g_keytone.sw_cond);
-		} else {
-			debug_msg("[%s] state is not STOP\n", __func__);
-			g_keytone.state = RENDER_COND_TIMED_WAIT;
-			gettimeofday(&tv, NULL);
-			timeout.tv_sec = tv.tv_sec + TIMEOUT_SEC;
-			timeout.tv_nsec = tv.tv_usec;
-			stat = pthread_cond_timedwait(&g_keytone.sw_cond, &g_keytone.sw_lock, &timeout);
-			if(stat == ETIMEDOUT && g_keytone.state != RENDER_START) {
-				debug_msg("[%s] Do audio handle close and set state to STOPPED\n", __func__);
-				if(AVSYS_FAIL(avsys_audio_close(g_keytone.handle)))	{
-					debug_critical("avsys_audio_close() failed !!!!!!!!\n");
-				}
+	if (v && v->left >= channel->period && ((unsigned long)v->pos & (sizeof(short) - 1)) == 0) {
+		/* Single voice with a whole period left : write from the mapped source */
+		avsys_audio_write(channel->handle, (void *)v->pos, channel->period);
+		v->pos += channel->period / sizeof(short);
+		v->left -= channel->period / sizeof(short) * sizeof(short);
+	} else {
+		__MMSoundKeytoneMix(voice, g_outbuf, channel->period);
+		avsys_audio_write(channel->handle, (void *)g_outbuf, channel->period);
+	}
+
+	channel->active = 0;
+	for (i = 0; i < KEYTONE_VOICE_MAX; i++) {
+		if (!voice[i].active)
+			continue;
+		if (voice[i].first) {
+			__MMSoundKeytoneLatency(&voice[i]);
+			voice[i].first = MMSOUND_FALSE;
+		}
+		if (voice[i].left == 0)
+			__MMSoundKeytoneVoiceRelease(&voice[i]);
+		else
+			channel->active++;
+	}
+
+	if (channel->active == 0)
+		channel->flush = MMSOUND_TRUE;
+}
+
+/*
+ * Close handles idle for longer than their keep-alive.
+ * Returns msec until the next one expires, -1 if no handle is left open.
+ */
+static int __MMSoundKeytoneExpire(void)
+{
+	keytone_channel_t *channel;
+	struct timespec now;
+	unsigned int keep;
+	long idle_ms;
+	int next = -1;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	for (i = 0; i < KEYTONE_CHANNEL_MAX; i++) {
+		channel = &g_channel[i];
+		if (!channel->created || channel->active || channel->flush)
+			continue;
+
+		keep = __MMSoundKeytoneKeepAlive(channel);
+		idle_ms = __MMSoundKeytoneSpan(&channel->idle_since, &now) / 1000;
+		if (idle_ms >= (long)keep) {
+			debug_msg("[%s] Do audio handle close of volume type %d after %u ms keep-alive (interval %u ms)\n",
+					__func__, channel->vol_type, keep, channel->interval_ms);
+			__MMSoundKeytoneChannelClose(channel);
+			debug_msg("[%s] presses %u, opens %u, cold %u (max %u us), warm %u (max %u us)\n", __func__,
+					g_stats.presses, g_stats.opens, g_stats.cold_count, g_stats.cold_max_us,
+					g_stats.warm_count, g_stats.warm_max_us);
+			continue;
+		}
+		if (next == -1 || (long)keep - idle_ms < next)
+			next = (int)((long)keep - idle_ms);
+	}
+
+	return next;
+}
+
+/* Sleep until a press comes or the next idle handle has to be closed */
+static void __MMSoundKeytoneIdle(void)
+{
+	struct pollfd pfd;
+	uint64_t count;
+	int timeout;
+	int state;
+
+	if (g_queue_tail != g_queue_head)
+		return;
 
-				g_CreatedFlag = MMSOUND_FALSE;
-				g_keytone.state = RENDER_STOPED;
+	timeout = __MMSoundKeytoneExpire();
+	state = (timeout >= 0) ? RENDER_COND_TIMED_WAIT : RENDER_STOPED_N_WAIT;
+	g_keytone.state = state;
+	__sync_synchronize();	/* state before queue index, pairs with __MMSoundKeytoneWake() */
+
+	/* A press pushed after this check sees the idle state and sends a wakeup */
+	if (g_queue_tail == g_queue_head) {
+		pfd.fd = g_keytone.wake_fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (state == RENDER_STOPED_N_WAIT)
+			debug_log ("[%s] set state to STOPPED_N_WAIT and wait\n", __func__);
+
+		poll(&pfd, 1, timeout);
+	}
+
+	/* Consume a wakeup sent after the state changed, it is not needed any more */
+	if (read(g_keytone.wake_fd, &count, sizeof(count)) == -1 && errno != EAGAIN)
+		debug_error("Fail to read wake event. errno=[%d]\n", errno);
+
+	g_keytone.state = RENDER_STARTED;
+}
+
+static int _MMSoundKeytoneRender(void *param_not_used)
+{
+	keytone_channel_t *channel;
+	int active;
+	int i;
+
+	memset(g_channel, 0, sizeof(g_channel));
+
+	while(stop_flag) {
+		__MMSoundKeytoneTakePresses();
+
+		/* One period per playing channel, each handle paces its own device buffer */
+		active = 0;
+		for (i = 0; i < KEYTONE_CHANNEL_MAX; i++) {
+			channel = &g_channel[i];
+			if (channel->active)
+				__MMSoundKeytoneChannelRender(channel);
+
+			if (channel->active) {
+				active++;
+			} else if (channel->flush && g_queue_tail == g_queue_head) {
+				/* Last voice ended : push its tail out of the device buffer */
+				avsys_audio_write(channel->handle, (void *)g_zerobuf, channel->period);
+				avsys_audio_write(channel->handle, (void *)g_zerobuf, channel->period);
+				channel->flush = MMSOUND_FALSE;
+				clock_gettime(CLOCK_MONOTONIC, &channel->idle_since);
 			}
-		} /* while(stop_flag) */
+		}
 
-		pthread_mutex_unlock(&g_keytone.sw_lock);
+		if (active == 0)
+			__MMSoundKeytoneIdle();
 	}
+
+	for (i = 0; i < KEYTONE_CHANNEL_MAX; i++)
+		__MMSoundKeytoneChannelClose(&g_channel[i]);
 	return MMSOUND_FALSE;
 }
 
-static int __MMSoundKeytoneParse(MMSourceType *source, mmsound_codec_info_t *info)
+static void __MMSoundKeytonePrefault(const MMSourceType *source)
 {
-	struct __riff_chunk
-	{
-		long chunkid;
-		long chunksize;
-		long rifftype;
-	};
-
-	struct __wave_chunk
-	{
-		long chunkid;
-		long chunksize;
-		unsigned short compression;
-		unsigned short channels;
-		unsigned long samplerate;
-		unsigned long avgbytepersec;
-		unsigned short blockkalign;
-		unsigned short bitspersample;
-	};
-
-	struct __data_chunk
-	{
-		long chunkid;
-		long chunkSize;
-	};
-
-	struct __riff_chunk *priff = NULL;
-	struct __wave_chunk *pwav = NULL;
-	struct __data_chunk *pdata = NULL;
-//	struct __fmt_chunk *pfmt  = NULL;
-
-	int datalen = -1;
-	char *data = NULL;
-	unsigned int tSize;
+	const volatile char *ptr = (const volatile char *)source->ptr;
+	long page = sysconf(_SC_PAGESIZE);
+	unsigned long start;
+	unsigned int i;
+	char sum = 0;
+
+	if (ptr == NULL || page <= 0)
+		return;
+
+	start = (unsigned long)source->ptr & ~(page - 1);
+	if (madvise((void *)start, (unsigned long)source->ptr - start + source->cur_size, MADV_WILLNEED) == -1)
+		debug_warning("madvise failed. errno=[%d][%s]\n", errno, strerror(errno));
+
+	/* Touch every page so the first press does not take page faults */
+	for (i = 0; i < source->cur_size; i += page)
+		sum += ptr[i];
+	(void)sum;
+}
 
-	debug_enter("\n");
+static int _MMSoundKeytoneBankRegister(const char *filename, int *keytone_id)
+{
+	keytone_bank_entry_t *entry = NULL;
+	int ret = MM_ERROR_NONE;
+	int i;
 
-	data = MMSourceGetPtr(source);
-	datalen = MMSourceGetCurSize(source);
+	debug_enter("(%s)\n", filename);
 
-#if defined(_DEBUG_VERBOS_)
-	debug_msg("source ptr :[%p]\n", data);
-	debug_msg("source size :[%d]\n", datalen);
-#endif
-	priff = (struct __riff_chunk *) data;
+	if (strlen(filename) >= FILE_FULL_PATH)
+		return MM_ERROR_SOUND_INVALID_PATH;
 
-	/* Must be checked, Just for wav or not */
-	if (priff->chunkid != RIFF_CHUNK_ID ||priff->rifftype != RIFF_CHUNK_TYPE)
-		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+	pthread_mutex_lock(&g_bank_lock);
 
-	if(priff->chunksize != datalen -8)
-		priff->chunksize = (datalen-8);
+	for (i = 0; i < g_bank_count; i++) {
+		if (strcmp(g_bank[i].filename, filename) == 0) {
+			debug_msg("[%s] already registered as [%d]\n", filename, i);
+			*keytone_id = i;
+			goto exit;
+		}
+	}
 
-	if (priff->chunkid != RIFF_CHUNK_ID ||priff->chunksize != datalen -8 ||priff->rifftype != RIFF_CHUNK_TYPE) {
-		debug_msg("This contents is not RIFF file\n");
-#if defined(_DEBUG_VERBOS_)
-		debug_msg("cunkid : %ld, chunksize : %ld, rifftype : 0x%lx\n", priff->chunkid, priff->chunksize, priff->rifftype);
-		debug_msg("cunkid : %ld, chunksize : %d, rifftype : 0x%lx\n", RIFF_CHUNK_ID, datalen-8, RIFF_CHUNK_TYPE);
-#endif
-		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+	if (g_bank_count >= KEYTONE_BANK_MAX) {
+		debug_error("Keytone bank is full (%d)\n", KEYTONE_BANK_MAX);
+		ret = MM_ERROR_SOUND_NO_FREE_SPACE;
+		goto exit;
 	}
-#if defined(_DEBUG_VERBOS_)
-	debug_msg("cunkid : %ld, chunksize : %ld, rifftype : %lx\n", priff->chunkid, priff->chunksize, priff->rifftype);
-	debug_msg("cunkid : %ld, chunksize : %d, rifftype : %lx\n", RIFF_CHUNK_ID, datalen-8, RIFF_CHUNK_TYPE);
-#endif
-	tSize = sizeof(struct __riff_chunk);
-	pdata = (struct __data_chunk*)(data+tSize);
-
-	while (pdata->chunkid != FMT_CHUNK_ID && tSize < datalen) {
-		tSize += (pdata->chunkSize+8);
-
-		if (tSize >= datalen) {
-			debug_warning("Wave Parsing is Finished : unable to find the Wave Format chunk\n");
-			return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
-		} else {
-			pdata = (struct __data_chunk*)(data+tSize);
-		}
+
+	entry = &g_bank[g_bank_count];
+	memset(entry, 0, sizeof(keytone_bank_entry_t));
+
+	ret = mm_source_open_file(filename, &entry->source, MM_SOURCE_NOT_DRM_CONTENTS);
+	if (ret != MM_ERROR_NONE) {
+		debug_error("Cannot open [%s] : %x\n", filename, ret);
+		goto exit;
 	}
-	pwav = (struct __wave_chunk*)(data+tSize);
 
-	if (pwav->chunkid != FMT_CHUNK_ID ||
-		   pwav->compression != WAVE_CODE_PCM ||	/* Only supported PCM */
-		   pwav->avgbytepersec != pwav->samplerate * pwav->blockkalign ||
-		   pwav->blockkalign != (pwav->bitspersample >> 3)*pwav->channels) {
-		debug_msg("This contents is not supported wave file\n");
-#if defined(_DEBUG_VERBOS_)
-		debug_msg("chunkid : 0x%lx, comp : 0x%x, av byte/sec : %lu, blockalign : %d\n", pwav->chunkid, pwav->compression, pwav->avgbytepersec, pwav->blockkalign);
-#endif
-		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+	ret = __MMSoundKeytoneParse(&entry->source, &entry->info);
+	if (ret != MM_ERROR_NONE || entry->info.doffset + entry->info.size > entry->source.cur_size) {
+		debug_error("Fail to parse [%s] : %x\n", filename, ret);
+		mm_source_close(&entry->source);
+		ret = MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+		goto exit;
 	}
 
-	/* Only One data chunk support */
+	__MMSoundKeytonePrefault(&entry->source);
+
+	strncpy(entry->filename, filename, FILE_FULL_PATH - 1);
+	*keytone_id = g_bank_count++;
+	debug_msg("[%s] registered as [%d], %d bytes\n", filename, *keytone_id, entry->info.size);
+
+exit:
+	pthread_mutex_unlock(&g_bank_lock);
+	debug_leave("\n");
+	return ret;
+}
+
+static int _MMSoundKeytoneBankGet(int keytone_id, const char *filename, MMSourceType *source, mmsound_codec_info_t *info)
+{
+	int ret = MM_ERROR_SOUND_FILE_NOT_FOUND;
+	int i;
 
-	tSize += (pwav->chunksize+8);
-	pdata = (struct __data_chunk *)(data+tSize);
+	pthread_mutex_lock(&g_bank_lock);
 
-	while (pdata->chunkid != DATA_CHUNK_ID && tSize < datalen) {
-		tSize += (pdata->chunkSize+8);
-		if (tSize >= datalen) {
-			debug_warning("Wave Parsing is Finished : unable to find the data chunk\n");
-			return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
-		} else {
-			pdata = (struct __data_chunk*)(data+tSize);
+	if (keytone_id != KEYTONE_ID_NONE) {
+		if (keytone_id >= 0 && keytone_id < g_bank_count) {
+			*source = g_bank[keytone_id].source;
+			*info = g_bank[keytone_id].info;
+			ret = MM_ERROR_NONE;
 		}
+	} else {
+		for (i = 0; i < g_bank_count; i++) {
+			if (strcmp(g_bank[i].filename, filename) == 0) {
+				*source = g_bank[i].source;
+				*info = g_bank[i].info;
+				ret = MM_ERROR_NONE;
+				break;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&g_bank_lock);
+	return ret;
+}
+
+static int __MMSoundKeytoneParse(MMSourceType *source, mmsound_codec_info_t *info)
+{
+	mm_sound_wav_info_t *wav = &info->wav;
+
+	debug_enter("\n");
+
+	if (mm_source_get_wav_info(source, wav) != MM_ERROR_NONE) {
+		debug_msg("This contents is not supported wave file\n");
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
+	}
+	/* Voices are mixed as 16 bits samples */
+	if (wav->format != MM_SOUND_WAV_FORMAT_PCM || wav->bits != 16 || wav->channels > 2) {
+		debug_msg("keytone must be 16 bits PCM, mono or stereo (format 0x%x, %d bits, %d ch)\n",
+				wav->format, wav->bits, wav->channels);
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
 	}
 
 	info->codec = MM_SOUND_SUPPORTED_CODEC_WAVE;
-	info->channels = pwav->channels;
-	info->format = pwav->bitspersample;
-	info->samplerate = pwav->samplerate;
-	info->doffset = (tSize+8);
-	info->size = pdata->chunkSize;
+	info->channels = wav->channels;
+	info->format = wav->bits;
+	info->samplerate = wav->samplerate;
+	info->doffset = wav->data_offset;
+	info->size = wav->data_size;
 	debug_msg("info->size:%d\n", info->size);
 	debug_leave("\n");
 	return MM_ERROR_NONE;
@@ -22,6 +22,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <errno.h>
 
 #include <semaphore.h>
 #include <unistd.h>
@@ -31,12 +33,16 @@
 
 #include "../../include/mm_sound_thread_pool.h"
 #include "../../include/mm_sound_plugin_codec.h"
+#include "../../include/mm_sound_tone_table.h"
 #include <mm_error.h>
 #include <mm_debug.h>
 #include <mm_sound.h>
+#include <mm_sound_pool.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <time.h>
 
 /* For Beep */
 #include <fcntl.h>
@@ -57,6 +63,26 @@
 #define MAX_DURATION 100
 #define TONE_COLUMN 6
 
+#define TONE_PARTIAL_NUM 3		/* low, middle and high frequency */
+#define TONE_TABLE_BITS 10
+#define TONE_TABLE_SIZE (1 << TONE_TABLE_BITS)
+#define TONE_FRAC_BITS (32 - TONE_TABLE_BITS)
+#define TONE_BLOCK_SIZE 256		/* samples mixed at once */
+
+#define TONE_FADE_OUT_MS 5			/* ramp written after a stop instead of cutting the tone */
+#define TONE_CLOSE_QUEUE 8			/* stopped devices waiting for the close worker */
+#define TONE_RING_DEPTH 2			/* periods rendered ahead of the device */
+#define TONE_RING_MAX_DEPTH 8
+#define TONE_RING_DEPTH_ENV "MM_SOUND_TONE_RENDER_AHEAD"
+#define TONE_WALK_LIMIT 1024		/* max rows walked while compiling a tone set */
+#define TONE_PLAN_MAX_STEP 256
+#define TONE_POOL_COUNT 4			/* tones played at once without malloc() */
+#define TONE_RING_POOL_BLOCK (16 * 1024)	/* render ring of the common device period */
+#define TONE_SEGMENT_MAX_DURATION (INT_MAX / SAMPLERATE)
+
+#define TONE_CACHE_ARENA_SIZE (4 * 1024 * 1024)	/* upper bound of prerendered PCM */
+#define TONE_CACHE_MAX_ENTRY 128
+
 typedef enum {
    STATE_NONE = 0,
    STATE_READY,
@@ -65,37 +91,15 @@ typedef enum {
    STATE_STOP,
 } state_e;
 
-typedef enum {
-	CONTROL_STOPPED,
-	CONTROL_READY,
-	CONTROL_STARTING,
-	CONTROL_PLAYING,
-} control_e;
-
+/* State changes of a play, its thread waits on cond for them */
 typedef struct {
 	pthread_mutex_t syncker;
 	pthread_cond_t cond;
-	int state;
 } tone_control_t;
 
 typedef struct {
-     /* AMR Buffer */
-	int				size; /* sizeof hole amr data */
-
-     /* Audio Infomations */
-	avsys_handle_t	     audio_handle;
-
-     /* control Informations */
-	int				repeat_count;
-	int				(*stop_cb)(int);
-	int				cb_param;
-	int				state;
-	int				number;
-	double			volume;
-	int				time;
-	int				pid;
-
-} tone_info_t;
+	unsigned int phase[TONE_PARTIAL_NUM];	/* phase accumulator of each partial */
+} tone_osc_t;
 
 typedef enum
 {
@@ -117,6 +121,86 @@ typedef struct st_tone
 	int	loopIndx;
 } TONE;
 
+/* Prerendered loop of one frequency set at full scale, 'length' samples wrap seamlessly */
+typedef struct {
+	float			low_frequency;
+	float			middle_frequency;
+	float			high_frequency;
+	const short		*pcm;
+	int				length;
+} tone_cache_entry_t;
+
+/* Tone table mapped from MM_SOUND_TONE_TABLE_PATH, read-only */
+typedef struct {
+	void			*base;
+	size_t			size;
+	const mm_sound_tone_table_index_t	*index;
+	const int		*rows;
+	int				tone_count;
+	int				row_count;
+} tone_table_t;
+
+typedef struct {
+	pthread_mutex_t	lock;
+	char			*arena;
+	int				used;
+	int				failed;
+	int				count;
+	tone_cache_entry_t	entry[TONE_CACHE_MAX_ENTRY];
+} tone_cache_t;
+
+/* One segment of a compiled tone set */
+typedef struct {
+	TONE			tone;
+	int				samples;		/* -1 : continuous */
+	const tone_cache_entry_t	*cache;	/* loop of the segment, NULL : synthesized */
+} tone_step_t;
+
+typedef struct {
+	tone_step_t		*step;
+	int				count;
+	int				restart;		/* step played after the last one */
+} tone_plan_t;
+
+typedef struct {
+	const tone_plan_t	*plan;
+	int				step;
+	int				seg_left;		/* samples left in the step, -1 : continuous */
+	long long		total_left;		/* samples left in the tone, -1 : infinite */
+	int				cache_pos;
+	tone_osc_t		osc;
+} tone_cursor_t;
+
+typedef struct {
+     /* PCM Buffer */
+	int				size; /* device period in bytes */
+	char			*ring; /* ring_depth periods, rendered ahead of the device */
+	int				ring_depth;
+
+     /* Audio Infomations */
+	avsys_handle_t	     audio_handle;
+
+     /* Tone Informations */
+	tone_plan_t		plan;
+
+     /* control Informations */
+	int				repeat_count;
+	int				(*stop_cb)(int);
+	int				cb_param;
+	int				state;
+	tone_control_t	control;
+	struct timespec	stop_time;	/* Stop() request */
+	int				number;
+	double			volume;
+	int				time;
+	int				pid;
+
+} tone_info_t;
+
+static mm_sound_pool_t g_tone_pool = MM_SOUND_POOL_INITIALIZER("tone info", sizeof(tone_info_t), TONE_POOL_COUNT);
+static mm_sound_pool_t g_ring_pool = MM_SOUND_POOL_INITIALIZER("tone ring", TONE_RING_POOL_BLOCK, TONE_POOL_COUNT);
+static mm_sound_pool_t g_plan_pool = MM_SOUND_POOL_INITIALIZER("tone plan", TONE_PLAN_MAX_STEP * sizeof(tone_step_t), TONE_POOL_COUNT);
+
  static const int TONE_SEGMENT[][MM_SOUND_TONE_NUM] =
  {
 	{941,	1336,	0,	-1,	0,	0,
@@ -717,12 +801,29 @@ typedef struct st_tone
 	-1,	-1,	-1,	-1,	0,	0}, //CDMA_SIGNAL_OFF - silent tone
  };
 
-static tone_control_t g_control;
+static short g_sine_table[TONE_TABLE_SIZE + 1];	/* one more point for interpolation */
+static pthread_once_t g_sine_table_once = PTHREAD_ONCE_INIT;
+static tone_cache_t g_cache = { PTHREAD_MUTEX_INITIALIZER, };
+static tone_table_t g_table;
+
+/* Devices of stopped tones, drained and closed by one worker so that the play thread goes back to the pool */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	avsys_handle_t queue[TONE_CLOSE_QUEUE];
+	int head;
+	int count;
+	int started;
+} g_closer = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, };
+static pthread_once_t g_table_once = PTHREAD_ONCE_INIT;
 static int (*g_thread_pool_func)(void*, void (*)(void*)) = NULL;
 
-static int _MMSoundToneInit(void);
-static int _MMSoundToneFini(void);
 static void _running_tone(void *param);
+static void _tone_init_table(void);
+static int _tone_get_ring_depth(void);
+static void _tone_load_table(void);
+static int _tone_compile_predefined(int tone, tone_plan_t *plan);
+static int _tone_compile_sequence(const MMSoundToneSegment_t *segments, int count, tone_plan_t *plan);
 
 
 
@@ -751,7 +852,9 @@ int MMSoundPlugCodecToneCreate(mmsound_codec_param_t *param, mmsound_codec_info_
 
 	debug_enter("\n");
 
-	toneInfo = (tone_info_t *)malloc(sizeof(tone_info_t));
+	pthread_once(&g_sine_table_once, _tone_init_table);
+
+	toneInfo = (tone_info_t *)mm_sound_pool_alloc(&g_tone_pool, sizeof(tone_info_t));
 	if (toneInfo == NULL) {
 		debug_error("memory allocation error\n");
 		return MM_ERROR_OUT_OF_MEMORY;
@@ -759,8 +862,17 @@ int MMSoundPlugCodecToneCreate(mmsound_codec_param_t *param, mmsound_codec_info_
 
 	memset(toneInfo, 0, sizeof(tone_info_t));
 
+	pthread_mutex_init(&toneInfo->control.syncker, NULL);
+	pthread_cond_init(&toneInfo->control.cond, NULL);
 	toneInfo->state = STATE_READY;
 
+	if (param->segments)
+		result = _tone_compile_sequence(param->segments, param->segment_count, &toneInfo->plan);
+	else
+		result = _tone_compile_predefined(param->tone, &toneInfo->plan);
+	if (result != MM_ERROR_NONE)
+		goto Error;
+
 	/* set audio param */
 	memset (&audio_param, 0, sizeof(avsys_audio_param_t));
 
@@ -780,6 +892,20 @@ int MMSoundPlugCodecToneCreate(mmsound_codec_param_t *param, mmsound_codec_info_
 	}
 	debug_log("Create audio_handle is %d\n", toneInfo->audio_handle);
 
+	/* The device period is the render unit, round it to whole samples */
+	toneInfo->size &= ~((SAMPLE_SIZE / 8) - 1);
+	if (toneInfo->size <= 0)
+		toneInfo->size = ((MAX_DURATION * SAMPLERATE / 1000) * SAMPLE_SIZE * CHANNELS) / 8;
+
+	toneInfo->ring_depth = _tone_get_ring_depth();
+	toneInfo->ring = (char *)mm_sound_pool_alloc(&g_ring_pool, toneInfo->size * toneInfo->ring_depth);
+	if (toneInfo->ring == NULL) {
+		debug_error("ring buffer allocation error\n");
+		result = MM_ERROR_OUT_OF_MEMORY;
+		goto Error;
+	}
+	debug_msg("period : %d bytes, render ahead : %d periods\n", toneInfo->size, toneInfo->ring_depth);
+
 
 	debug_msg("tone : %d\n", param->tone);
 	debug_msg("repeat : %d\n", param->repeat_count);
@@ -811,7 +937,11 @@ Error:
 		if(toneInfo->audio_handle)
 			avsys_audio_close(toneInfo->audio_handle);
 
-		free(toneInfo);
+		mm_sound_pool_free(&g_ring_pool, toneInfo->ring);
+		mm_sound_pool_free(&g_plan_pool, toneInfo->plan.step);
+		pthread_cond_destroy(&toneInfo->control.cond);
+		pthread_mutex_destroy(&toneInfo->control.syncker);
+		mm_sound_pool_free(&g_tone_pool, toneInfo);
 	}
 
 	return result;
@@ -829,13 +959,78 @@ int MMSoundPlugCodecToneDestroy(MMHandleType handle)
 
 	debug_enter("(handle %x)\n", handle);
 
-	if (toneInfo)
-		free (toneInfo);
+	mm_sound_pool_free(&g_ring_pool, toneInfo->ring);
+	mm_sound_pool_free(&g_plan_pool, toneInfo->plan.step);
+	pthread_cond_destroy(&toneInfo->control.cond);
+	pthread_mutex_destroy(&toneInfo->control.syncker);
+	mm_sound_pool_free(&g_tone_pool, toneInfo);
 
 	debug_leave("\n");
 	return err;
 }
 
+/* Sets the state and wakes the play thread waiting for a change */
+static void _tone_set_state(tone_info_t *toneInfo, int state)
+{
+	pthread_mutex_lock(&toneInfo->control.syncker);
+	toneInfo->state = state;
+	pthread_cond_signal(&toneInfo->control.cond);
+	pthread_mutex_unlock(&toneInfo->control.syncker);
+}
+
+static void _tone_close(avsys_handle_t audio_handle)
+{
+	int result;
+
+	avsys_audio_drain(audio_handle);
+
+	result = avsys_audio_close(audio_handle);
+	if(AVSYS_FAIL(result))	{
+		debug_error("Device Close Error 0x%x\n", result);
+	}
+}
+
+static void *_tone_closer(void *arg)
+{
+	avsys_handle_t audio_handle;
+
+	for (;;) {
+		pthread_mutex_lock(&g_closer.lock);
+		while (g_closer.count == 0)
+			pthread_cond_wait(&g_closer.cond, &g_closer.lock);
+		audio_handle = g_closer.queue[g_closer.head];
+		g_closer.head = (g_closer.head + 1) % TONE_CLOSE_QUEUE;
+		g_closer.count--;
+		pthread_mutex_unlock(&g_closer.lock);
+
+		_tone_close(audio_handle);
+	}
+	return NULL;
+}
+
+/* Hands the close to the worker, started on first use. Closes in place when it cannot. */
+static void _tone_close_deferred(avsys_handle_t audio_handle)
+{
+	pthread_t thread;
+
+	pthread_mutex_lock(&g_closer.lock);
+	if (!g_closer.started && pthread_create(&thread, NULL, _tone_closer, NULL) == 0) {
+		pthread_detach(thread);
+		g_closer.started = 1;
+	}
+	if (g_closer.started && g_closer.count < TONE_CLOSE_QUEUE) {
+		g_closer.queue[(g_closer.head + g_closer.count) % TONE_CLOSE_QUEUE] = audio_handle;
+		g_closer.count++;
+		pthread_cond_signal(&g_closer.cond);
+		pthread_mutex_unlock(&g_closer.lock);
+		return;
+	}
+	pthread_mutex_unlock(&g_closer.lock);
+
+	debug_warning("close worker is not available, close in place\n");
+	_tone_close(audio_handle);
+}
+
 static
 int MMSoundPlugCodecTonePlay(MMHandleType handle)
 {
@@ -843,7 +1038,7 @@ int MMSoundPlugCodecTonePlay(MMHandleType handle)
 
 	debug_enter("(handle %x)\n", handle);
 
-	toneInfo->state = STATE_BEGIN;
+	_tone_set_state(toneInfo, STATE_BEGIN);
 	debug_msg("sent start signal\n");
 
 	debug_leave("\n");
@@ -851,116 +1046,182 @@ int MMSoundPlugCodecTonePlay(MMHandleType handle)
 	return MM_ERROR_NONE;
 }
 
-static char*
-_create_tone (double *sample, TONE _TONE, double volume, int *toneSize)
+static void _tone_init_table(void)
 {
-	short *pbuf;
-	double i = 0;
-	double amplitude, f1, f2, f3;
-	double volume_factor;
-	int quota= 0;
-	int DEFAULT_PACKET_INTERVAL = 10;
-	float low_frequency		= _TONE.low_frequency;
-	float middle_frequency	= _TONE.middle_frequency;
-	float high_frequency		= _TONE.high_frequency;
-	int sample_size = 0;
-
-	if(sample == NULL) {
-		debug_error("Sample buffer is not allocated\n");
-		return NULL;
+	int i;
+
+	for (i = 0; i <= TONE_TABLE_SIZE; i++)
+		g_sine_table[i] = (short)(32767 * sin(2 * M_PI * i / TONE_TABLE_SIZE));
+}
+
+/* Maps the tone table file. The built-in TONE_SEGMENT is used when it is missing or invalid */
+static void _tone_load_table(void)
+{
+	const mm_sound_tone_table_header_t *header = NULL;
+	const char *path = getenv(MM_SOUND_TONE_TABLE_ENV);
+	struct stat st;
+	void *base = MAP_FAILED;
+	int fd = -1;
+	int i;
+
+	if (path == NULL)
+		path = MM_SOUND_TONE_TABLE_PATH;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		debug_msg("No tone table %s, use built-in tones\n", path);
+		return;
 	}
 
-	/* Create a buffer for the tone */
-	if((_TONE.playingTime >  MAX_DURATION) || (_TONE.playingTime == -1) ) {
-		*toneSize = ((MAX_DURATION / 1000.) * SAMPLERATE * SAMPLE_SIZE * CHANNELS) / 8;
-	} else	 {
-		*toneSize = ((_TONE.playingTime / 1000.) * SAMPLERATE * SAMPLE_SIZE * CHANNELS) / 8;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(mm_sound_tone_table_header_t)) {
+		debug_error("Tone table %s is too short\n", path);
+		goto Error;
 	}
-	*toneSize = ((*toneSize+1)>>1)<<1;
-	sample_size = (*toneSize) / (SAMPLE_SIZE / 8);
 
-	debug_log("_TONE.playing_time: %d toneSize: %d\n", _TONE.playingTime, *toneSize);
-	char* buffer = g_malloc (*toneSize);
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		debug_error("Tone table %s mmap failed\n", path);
+		goto Error;
+	}
 
-	if(buffer == NULL) {
-		debug_error("Buffer is not allocated\n");
-		return NULL;
-	} else {
-		pbuf = (short*)buffer;
+	header = (const mm_sound_tone_table_header_t *)base;
+	if (header->magic != MM_SOUND_TONE_TABLE_MAGIC || header->version != MM_SOUND_TONE_TABLE_VERSION ||
+		header->column != TONE_COLUMN) {
+		debug_error("Tone table %s has unknown format\n", path);
+		goto Error;
+	}
 
-		if(_TONE.low_frequency > 0) {
-			quota++;
-		}
-		if(_TONE.middle_frequency > 0) {
-			quota++;
+	if ((header->index_offset % sizeof(uint32_t)) || (header->row_offset % sizeof(uint32_t)) ||
+		header->tone_count > (uint32_t)st.st_size / sizeof(mm_sound_tone_table_index_t) ||
+		header->row_count > (uint32_t)st.st_size / (TONE_COLUMN * sizeof(int)) ||
+		header->index_offset > st.st_size - header->tone_count * sizeof(mm_sound_tone_table_index_t) ||
+		header->row_offset > st.st_size - header->row_count * TONE_COLUMN * sizeof(int)) {
+		debug_error("Tone table %s is truncated\n", path);
+		goto Error;
+	}
+
+	g_table.index = (const mm_sound_tone_table_index_t *)((const char *)base + header->index_offset);
+	g_table.rows = (const int *)((const char *)base + header->row_offset);
+	for (i = 0; i < (int)header->tone_count; i++) {
+		if (g_table.index[i].first_row > header->row_count ||
+			g_table.index[i].row_count > header->row_count - g_table.index[i].first_row) {
+			debug_error("Tone table %s has invalid index of tone %d\n", path, i);
+			goto Error;
 		}
-		if(_TONE.high_frequency > 0) {
+	}
+
+	g_table.base = base;
+	g_table.size = st.st_size;
+	g_table.tone_count = header->tone_count;
+	g_table.row_count = header->row_count;
+	close(fd);
+
+	debug_msg("Tone table %s : %d tones, %d rows\n", path, g_table.tone_count, g_table.row_count);
+	return;
+
+Error:
+	if (base != MAP_FAILED)
+		munmap(base, st.st_size);
+	close(fd);
+	memset(&g_table, 0, sizeof(tone_table_t));
+}
+
+/* Number of periods rendered ahead of the device, TONE_RING_DEPTH unless overridden by the environment */
+static int _tone_get_ring_depth(void)
+{
+	const char *env = getenv(TONE_RING_DEPTH_ENV);
+	int depth = TONE_RING_DEPTH;
+
+	if (env) {
+		depth = atoi(env);
+		if (depth < 1)
+			depth = 1;
+		else if (depth > TONE_RING_MAX_DEPTH)
+			depth = TONE_RING_MAX_DEPTH;
+	}
+
+	return depth;
+}
+
+/* Renders 'count' samples of the given tone set into 'out'.
+ * Every partial keeps its own 32bit phase accumulator in 'osc', so the wave stays
+ * phase-continuous over chunk and segment boundaries regardless of the tone length. */
+static void
+_tone_render (tone_osc_t *osc, const TONE *_TONE, double volume, short *out, int count)
+{
+	int mix[TONE_BLOCK_SIZE];
+	unsigned int inc[TONE_PARTIAL_NUM];
+	int index[TONE_PARTIAL_NUM];
+	float frequency[TONE_PARTIAL_NUM];
+	int quota = 0;
+	int gain = 0;
+	int done = 0;
+	int i, n, k;
+
+	frequency[0] = _TONE->low_frequency;
+	frequency[1] = _TONE->middle_frequency;
+	frequency[2] = _TONE->high_frequency;
+
+	for (k = 0; k < TONE_PARTIAL_NUM; k++) {
+		if (frequency[k] > 0) {
+			inc[quota] = (unsigned int)(frequency[k] * 4294967296.0 / SAMPLERATE);
+			index[quota] = k;
 			quota++;
 		}
+	}
 
-		for (i = 0; i < sample_size; i++) {
-			/*
-			 * We add the fundamental frequencies together.
-			 */
+	if (quota == 0) {
+		memset(out, 0, count * sizeof(short));
+		return;
+	}
 
-			f1 = sin (2 * M_PI * low_frequency     	* ((*sample) / SAMPLERATE));
-			f2 = sin (2 * M_PI * middle_frequency	* ((*sample) / SAMPLERATE));
-			f3 = sin (2 * M_PI * high_frequency	* ((*sample) / SAMPLERATE));
+	/* Q15 gain, the sum of partials is divided by the number of partials */
+	gain = (int)(volume * 32768 / quota);
 
-			if(f1 + f2 + f3 != 0) {
-				amplitude = (f1 + f2 + f3) / quota;
-				/* Adjust the volume */
-				amplitude *= volume;
+	while (done < count) {
+		n = count - done;
+		if (n > TONE_BLOCK_SIZE)
+			n = TONE_BLOCK_SIZE;
 
-				/* Make the [-1:1] interval into a [-32767:32767] interval */
-				amplitude *= 32767;
-			} else {
-				amplitude = 0;
-			}
+		memset(mix, 0, n * sizeof(int));
+		for (k = 0; k < quota; k++) {
+			unsigned int phase = osc->phase[index[k]];
+			unsigned int step = inc[k];
 
-			/* Store it in the data buffer */
-			*(pbuf++) = (short) amplitude;
+			for (i = 0; i < n; i++) {
+				unsigned int pos = phase >> TONE_FRAC_BITS;
+				int frac = (phase >> (TONE_FRAC_BITS - 15)) & 0x7FFF;
+				int a = g_sine_table[pos];
+				int b = g_sine_table[pos + 1];
 
-			(*sample)++;
+				mix[i] += a + (((b - a) * frac) >> 15);
+				phase += step;
+			}
+			osc->phase[index[k]] = phase;
 		}
+
+		for (i = 0; i < n; i++)
+			out[done + i] = (short)((mix[i] * gain) >> 15);
+
+		done += n;
 	}
-	return buffer;
 }
 
 static TONE
-_mm_get_tone(int key, int CurIndex)
+_mm_get_tone(const int *rows, int CurIndex)
 {
 	TONE _TONE;
 
-	_TONE.low_frequency		= TONE_SEGMENT[key][CurIndex * TONE_COLUMN + LOW_FREQUENCY];
-	_TONE.middle_frequency	= TONE_SEGMENT[key][CurIndex * TONE_COLUMN + MIDDLE_FREQUENCY];
-	_TONE.high_frequency		= TONE_SEGMENT[key][CurIndex * TONE_COLUMN + HIGH_FREQUENCY];
-	_TONE.playingTime			= TONE_SEGMENT[key][CurIndex * TONE_COLUMN + PLAYING_TIME];
-	_TONE.loopCnt			= TONE_SEGMENT[key][CurIndex * TONE_COLUMN + LOOP_COUNT];
-	_TONE.loopIndx			= TONE_SEGMENT[key][CurIndex * TONE_COLUMN + LOOP_INDEX];
+	_TONE.low_frequency		= rows[CurIndex * TONE_COLUMN + LOW_FREQUENCY];
+	_TONE.middle_frequency	= rows[CurIndex * TONE_COLUMN + MIDDLE_FREQUENCY];
+	_TONE.high_frequency		= rows[CurIndex * TONE_COLUMN + HIGH_FREQUENCY];
+	_TONE.playingTime			= rows[CurIndex * TONE_COLUMN + PLAYING_TIME];
+	_TONE.loopCnt			= rows[CurIndex * TONE_COLUMN + LOOP_COUNT];
+	_TONE.loopIndx			= rows[CurIndex * TONE_COLUMN + LOOP_INDEX];
 
 	return _TONE;
 }
 
-static int
-_mm_get_waveCnt_PlayingTime(int toneTime, TONE _TONE, int *waveCnt, int *waveRestPlayTime)
-{
-	int ret = MM_ERROR_NONE;
-	if(waveCnt == NULL || waveRestPlayTime == NULL) {
-		debug_error("waveCnt || waveRestPlayTime buffer is NULL\n");
-		return MM_ERROR_SOUND_INTERNAL;
-	}
-	/*Set  wave count and wave playing time*/
-	if( _TONE.playingTime == -1) {
-		*waveCnt = abs(toneTime) /MAX_DURATION;
-		*waveRestPlayTime =  abs(toneTime) % MAX_DURATION;
-	} else {
-		*waveCnt = _TONE.playingTime /MAX_DURATION;
-		*waveRestPlayTime =  _TONE.playingTime % MAX_DURATION;
-	}
-	return ret;
-}
-
 static int
 _mm_get_CurIndex(TONE _TONE, int *CurArrayPlayCnt, int *CurIndex)
 {
@@ -985,10 +1246,380 @@ _mm_get_CurIndex(TONE _TONE, int *CurArrayPlayCnt, int *CurIndex)
 	return ret;
 }
 
+/* Returns the seamless loop length in samples of a set of integral frequencies,
+ * 0 when the set cannot be looped exactly */
+static int
+_tone_cache_loop_length(const TONE *_TONE)
+{
+	float frequency[TONE_PARTIAL_NUM];
+	int g = SAMPLERATE;
+	int a, b, t;
+	int k;
+
+	frequency[0] = _TONE->low_frequency;
+	frequency[1] = _TONE->middle_frequency;
+	frequency[2] = _TONE->high_frequency;
+
+	for (k = 0; k < TONE_PARTIAL_NUM; k++) {
+		if (frequency[k] <= 0)
+			continue;
+		if (frequency[k] != (float)(int)frequency[k] || frequency[k] >= SAMPLERATE / 2)
+			return 0;
+
+		a = g;
+		b = (int)frequency[k];
+		while (b) {
+			t = a % b;
+			a = b;
+			b = t;
+		}
+		g = a;
+	}
+
+	if (g == SAMPLERATE)	/* silence */
+		return 0;
+
+	return SAMPLERATE / g;
+}
+
+/* Looks up the cached loop of a frequency set, rendering it on first use.
+ * Entries are never modified nor freed once published, so the PCM can be read without the lock.
+ * Each loop starts on a page of its own, which is made read-only once it is rendered. */
+static const tone_cache_entry_t*
+_tone_cache_get(const TONE *_TONE)
+{
+	tone_cache_entry_t *entry = NULL;
+	struct timespec start, end;
+	float frequency[TONE_PARTIAL_NUM];
+	short *pcm = NULL;
+	int length = 0;
+	int quota = 0;
+	int size = 0;
+	int page = 0;
+	int i, k;
+
+	length = _tone_cache_loop_length(_TONE);
+	if (length == 0)
+		return NULL;
+
+	pthread_mutex_lock(&g_cache.lock);
+
+	for (i = 0; i < g_cache.count; i++) {
+		if (g_cache.entry[i].low_frequency == _TONE->low_frequency &&
+			g_cache.entry[i].middle_frequency == _TONE->middle_frequency &&
+			g_cache.entry[i].high_frequency == _TONE->high_frequency) {
+			entry = &g_cache.entry[i];
+			goto Done;
+		}
+	}
+
+	if (g_cache.arena == NULL && !g_cache.failed) {
+		g_cache.arena = mmap(NULL, TONE_CACHE_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (g_cache.arena == MAP_FAILED) {
+			debug_error("tone cache arena mmap failed\n");
+			g_cache.arena = NULL;
+			g_cache.failed = 1;
+		}
+	}
+
+	page = getpagesize();
+	size = (length * sizeof(short) + page - 1) & ~(page - 1);
+	if (g_cache.arena == NULL || g_cache.count >= TONE_CACHE_MAX_ENTRY || g_cache.used + size > TONE_CACHE_ARENA_SIZE) {
+		debug_log("tone cache is full, %0.f/%0.f/%0.f will be synthesized\n",
+			_TONE->low_frequency, _TONE->middle_frequency, _TONE->high_frequency);
+		goto Done;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	frequency[0] = _TONE->low_frequency;
+	frequency[1] = _TONE->middle_frequency;
+	frequency[2] = _TONE->high_frequency;
+	for (k = 0; k < TONE_PARTIAL_NUM; k++) {
+		if (frequency[k] > 0)
+			quota++;
+	}
+
+	pcm = (short*)(g_cache.arena + g_cache.used);
+	for (i = 0; i < length; i++) {
+		double sample = 0;
+
+		for (k = 0; k < TONE_PARTIAL_NUM; k++) {
+			if (frequency[k] > 0)
+				sample += sin(2 * M_PI * fmod((double)frequency[k] * i, SAMPLERATE) / SAMPLERATE);
+		}
+		pcm[i] = (short)lrint(32767 * sample / quota);
+	}
+
+	if (mprotect(pcm, size, PROT_READ) < 0)
+		debug_warning("tone cache loop could not be made read-only, errno %d\n", errno);
+
+	entry = &g_cache.entry[g_cache.count];
+	entry->low_frequency = _TONE->low_frequency;
+	entry->middle_frequency = _TONE->middle_frequency;
+	entry->high_frequency = _TONE->high_frequency;
+	entry->pcm = pcm;
+	entry->length = length;
+	g_cache.used += size;
+	g_cache.count++;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	debug_msg("tone cache : %0.f/%0.f/%0.f loop of %d samples rendered in %ld us, arena %d/%d bytes in %d entries\n",
+		_TONE->low_frequency, _TONE->middle_frequency, _TONE->high_frequency, length,
+		(end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000,
+		g_cache.used, TONE_CACHE_ARENA_SIZE, g_cache.count);
+
+Done:
+	pthread_mutex_unlock(&g_cache.lock);
+	return entry;
+}
+
+/* Copies 'count' samples of a cached loop starting at '*pos', applying the volume */
+static void
+_tone_cache_copy(const tone_cache_entry_t *entry, int *pos, double volume, short *out, int count)
+{
+	int gain = (int)(volume * 32768);
+	int done = 0;
+	int n, i;
+
+	while (done < count) {
+		const short *src = entry->pcm + *pos;
+
+		n = entry->length - *pos;
+		if (n > count - done)
+			n = count - done;
+
+		for (i = 0; i < n; i++)
+			out[done + i] = (short)((src[i] * gain) >> 15);
+
+		done += n;
+		*pos += n;
+		if (*pos == entry->length)
+			*pos = 0;
+	}
+}
+
+/* Compiles a tone set of TONE_COLUMN wide rows into a flat render plan.
+ * The rows are walked the way the table has always been played, until the walk reaches
+ * a (row, loop pass) state already seen; the plan then restarts at the step recorded for it. */
+static int
+_tone_compile(const int *rows, int row_count, tone_plan_t *plan)
+{
+	int visit_index[TONE_WALK_LIMIT];
+	int visit_count[TONE_WALK_LIMIT];
+	int visit_step[TONE_WALK_LIMIT];
+	int visited = 0;
+	int CurIndex = 0;
+	int CurArrayPlayCnt = 0;
+	int walk, i;
+	TONE _TONE;
+
+	memset(plan, 0, sizeof(tone_plan_t));
+	plan->step = (tone_step_t *)mm_sound_pool_alloc(&g_plan_pool, TONE_PLAN_MAX_STEP * sizeof(tone_step_t));
+	if (plan->step == NULL) {
+		debug_error("plan allocation error\n");
+		return MM_ERROR_OUT_OF_MEMORY;
+	}
+
+	for (walk = 0; walk < TONE_WALK_LIMIT; walk++) {
+		if (CurIndex < 0 || CurIndex >= row_count) {
+			debug_error("segment index %d is out of range\n", CurIndex);
+			goto Error;
+		}
+
+		_TONE = _mm_get_tone(rows, CurIndex);
+		if (_TONE.low_frequency == -1) { /* end of the tone set, jump to the loop index */
+			CurIndex = _TONE.loopIndx;
+			continue;
+		}
+
+		if (_TONE.playingTime < -1) {
+			debug_error("playing time of segment %d is invalid %d\n", CurIndex, _TONE.playingTime);
+			goto Error;
+		}
+
+		for (i = 0; i < visited; i++) {
+			if (visit_index[i] == CurIndex && visit_count[i] == CurArrayPlayCnt) {
+				plan->restart = visit_step[i];
+				goto Done;
+			}
+		}
+		visit_index[visited] = CurIndex;
+		visit_count[visited] = CurArrayPlayCnt;
+		visit_step[visited] = plan->count;
+		visited++;
+
+		if (_TONE.playingTime != 0) {
+			tone_step_t *step = &plan->step[plan->count];
+
+			if (plan->count == TONE_PLAN_MAX_STEP) {
+				debug_error("tone set is longer than %d segments\n", TONE_PLAN_MAX_STEP);
+				goto Error;
+			}
+
+			step->tone = _TONE;
+			step->samples = (_TONE.playingTime == -1) ? -1 : (int)(((long long)_TONE.playingTime * SAMPLERATE) / 1000);
+			step->cache = _tone_cache_get(&_TONE);
+			plan->count++;
+
+			if (step->samples == -1) { /* continuous, nothing after it is ever played */
+				plan->restart = plan->count - 1;
+				goto Done;
+			}
+		}
+
+		_mm_get_CurIndex(_TONE, &CurArrayPlayCnt, &CurIndex);
+	}
+
+	debug_error("tone set does not repeat within %d segments\n", TONE_WALK_LIMIT);
+	goto Error;
+
+Done:
+	if (plan->count == 0) {
+		debug_error("tone set has no playable segment\n");
+		goto Error;
+	}
+	/* the walk came back to zero length rows only, the loop would play nothing */
+	if (plan->restart >= plan->count) {
+		debug_error("tone set loops without a playable segment\n");
+		goto Error;
+	}
+	debug_msg("tone plan : %d steps, restart at %d\n", plan->count, plan->restart);
+	return MM_ERROR_NONE;
+
+Error:
+	mm_sound_pool_free(&g_plan_pool, plan->step);
+	plan->step = NULL;
+	plan->count = 0;
+	return MM_ERROR_INVALID_ARGUMENT;
+}
+
+static int
+_tone_compile_predefined(int tone, tone_plan_t *plan)
+{
+	if (tone >= 0 && tone < g_table.tone_count && g_table.index[tone].row_count) {
+		return _tone_compile(g_table.rows + g_table.index[tone].first_row * TONE_COLUMN,
+							g_table.index[tone].row_count, plan);
+	}
+
+	if (tone < MM_SOUND_TONE_DTMF_0 || tone >= (int)(sizeof(TONE_SEGMENT) / sizeof(TONE_SEGMENT[0]))) {
+		debug_error("TONE Value is invalid %d\n", tone);
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+
+	/* not in the tone table file, use the built-in one */
+	return _tone_compile(TONE_SEGMENT[tone], MM_SOUND_TONE_NUM / TONE_COLUMN, plan);
+}
+
+/* Validates a user tone sequence and compiles it as a tone set which restarts from its first segment */
+static int
+_tone_compile_sequence(const MMSoundToneSegment_t *segments, int count, tone_plan_t *plan)
+{
+	int rows[(MM_SOUND_TONE_SEQUENCE_MAX + 1) * TONE_COLUMN];
+	int *row = rows;
+	int i;
+
+	if (segments == NULL || count < 1 || count > MM_SOUND_TONE_SEQUENCE_MAX) {
+		debug_error("Segments are invalid %p, %d\n", segments, count);
+		return MM_ERROR_INVALID_ARGUMENT;
+	}
+
+	for (i = 0; i < count; i++, row += TONE_COLUMN) {
+		if (segments[i].low_frequency < 0 || segments[i].low_frequency >= SAMPLERATE / 2 ||
+			segments[i].middle_frequency < 0 || segments[i].middle_frequency >= SAMPLERATE / 2 ||
+			segments[i].high_frequency < 0 || segments[i].high_frequency >= SAMPLERATE / 2) {
+			debug_error("Frequency of segment %d is invalid\n", i);
+			return MM_ERROR_INVALID_ARGUMENT;
+		}
+		if (segments[i].duration < -1 || segments[i].duration > TONE_SEGMENT_MAX_DURATION) {
+			debug_error("Duration of segment %d is invalid %d\n", i, segments[i].duration);
+			return MM_ERROR_INVALID_ARGUMENT;
+		}
+		if (segments[i].loop_count < 0 || segments[i].loop_index < 0 || segments[i].loop_index > i) {
+			debug_error("Loop of segment %d is invalid %d, %d\n", i, segments[i].loop_count, segments[i].loop_index);
+			return MM_ERROR_INVALID_ARGUMENT;
+		}
+
+		row[LOW_FREQUENCY] = segments[i].low_frequency;
+		row[MIDDLE_FREQUENCY] = segments[i].middle_frequency;
+		row[HIGH_FREQUENCY] = segments[i].high_frequency;
+		row[PLAYING_TIME] = segments[i].duration;
+		row[LOOP_COUNT] = segments[i].loop_count;
+		row[LOOP_INDEX] = segments[i].loop_index;
+	}
+
+	/* terminator, back to the first segment */
+	row[LOW_FREQUENCY] = row[MIDDLE_FREQUENCY] = row[HIGH_FREQUENCY] = row[PLAYING_TIME] = -1;
+	row[LOOP_COUNT] = 0;
+	row[LOOP_INDEX] = 0;
+
+	return _tone_compile(rows, count + 1, plan);
+}
+
+static void
+_tone_cursor_init(tone_cursor_t *cursor, const tone_plan_t *plan, int toneTime)
+{
+	memset(cursor, 0, sizeof(tone_cursor_t));
+	cursor->plan = plan;
+	cursor->seg_left = plan->step[0].samples;
+
+	if (toneTime < 0)
+		cursor->total_left = -1;
+	else
+		cursor->total_left = ((long long)toneTime * SAMPLERATE) / 1000;
+}
+
+/* Renders up to 'count' samples from the cursor into 'out'.
+ * Returns the number of samples rendered, less than 'count' only at the end of the tone. */
+static int
+_tone_cursor_fill(tone_cursor_t *cursor, double volume, short *out, int count)
+{
+	const tone_step_t *step;
+	int filled = 0;
+	int n;
+
+	while (filled < count && cursor->total_left != 0) {
+		if (cursor->seg_left == 0) {
+			cursor->step++;
+			if (cursor->step == cursor->plan->count)
+				cursor->step = cursor->plan->restart;
+			cursor->seg_left = cursor->plan->step[cursor->step].samples;
+			cursor->cache_pos = 0;
+		}
+		step = &cursor->plan->step[cursor->step];
+
+		n = count - filled;
+		if (cursor->seg_left > 0 && n > cursor->seg_left)
+			n = cursor->seg_left;
+		if (cursor->total_left > 0 && n > cursor->total_left)
+			n = (int)cursor->total_left;
+
+		if (step->cache)
+			_tone_cache_copy(step->cache, &cursor->cache_pos, volume, out + filled, n);
+		else
+			_tone_render(&cursor->osc, &step->tone, volume, out + filled, n);
+
+		filled += n;
+		if (cursor->seg_left > 0)
+			cursor->seg_left -= n;
+		if (cursor->total_left > 0)
+			cursor->total_left -= n;
+	}
+
+	return filled;
+}
+
+/* Ramps 'count' samples down to silence */
+static void _tone_fade_out(short *pcm, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		pcm[i] = pcm[i] * (count - 1 - i) / count;
+}
+
 static void _running_tone(void *param)
 {
-	int result = AVSYS_STATE_SUCCESS;
-	char *ptoneBuf = NULL;
 	char filename[100];
 
 	if(param == NULL) {
@@ -996,20 +1627,20 @@ static void _running_tone(void *param)
 		return;
 	}
 	tone_info_t *toneInfo = (tone_info_t*) param;
+	tone_cursor_t cursor;
+	int length[TONE_RING_MAX_DEPTH];
+	int period = toneInfo->size / (SAMPLE_SIZE / 8);
 	int toneKey = 0;
 	int toneTime =0;
-	int prePlayingTime = 0;
-	int duration = 0;
-	int playingTime = 0;
-	int toneSize = 0;
-	int CurWaveIndex = 0;
-	int numWave = 0;
-	int waveRestPlayTime = 0;
-	int CurIndex = 0;
-	int CurArrayPlayCnt = 0;
+	int head = 0;
+	int stopped = 0;
+	int fade;
+	avsys_handle_t audio_handle;
+	struct timespec stop_time = { 0, 0 }, now;
+	int i;
 
 	debug_enter("\n");
-	double sample = 0;
+
 	toneTime = toneInfo->time;
 	if(toneTime != 0) {
 		toneKey = toneInfo->number;
@@ -1019,87 +1650,92 @@ static void _running_tone(void *param)
 		snprintf(filename, sizeof(filename), "/proc/%d/cmdline", toneInfo->pid);
 
 		debug_msg("Wait start signal\n");
-		while(toneInfo->state == STATE_READY)
-			usleep(10);
+		pthread_mutex_lock(&toneInfo->control.syncker);
+		while (toneInfo->state == STATE_READY)
+			pthread_cond_wait(&toneInfo->control.cond, &toneInfo->control.syncker);
 		debug_msg("Recv start signal\n");
-		toneInfo->state = STATE_PLAY;
+		if (toneInfo->state != STATE_STOP)
+			toneInfo->state = STATE_PLAY;
+		pthread_mutex_unlock(&toneInfo->control.syncker);
 	} else {
 		return;
 	}
 
-	while (1) {
-		TONE _TONE = _mm_get_tone(toneKey, CurIndex); /*Pop one of Tone Set */
-		if(_mm_get_waveCnt_PlayingTime(toneTime, _TONE, &numWave, &waveRestPlayTime) != MM_ERROR_NONE) {
-			debug_error("_mm_get_waveCnt_PlayingTime return value error\n");
-			goto exit;
-		}
-		debug_log ("Predefined Tone[%d] Total Play time (ms) : %d, _TONE.playing_time: %d _numWave = %d low_frequency: %0.f, middle_frequency: %0.f, high_frequency: %0.f\n",
-			CurIndex, toneTime, _TONE.playingTime, numWave, _TONE.low_frequency, _TONE.middle_frequency, _TONE.high_frequency);
+	_tone_cursor_init(&cursor, &toneInfo->plan, toneTime);
 
-		if (_TONE.low_frequency == -1) { /* skip frequency which's value is -1*/
-			CurIndex = _TONE.loopIndx;
-			continue;
-		}
+	/* Prime the ring, every slot holds the period following the previous slot */
+	for (i = 0; i < toneInfo->ring_depth; i++) {
+		length[i] = _tone_cursor_fill(&cursor, toneInfo->volume,
+						(short*)(toneInfo->ring + i * toneInfo->size), period) * (SAMPLE_SIZE / 8);
+	}
 
-		/* Write pcm data */
+	/* Write pcm data, the slot just written is refilled with the period ring_depth ahead */
+	while (length[head] > 0 && toneInfo->state == STATE_PLAY) {
+		avsys_audio_write(toneInfo->audio_handle, toneInfo->ring + head * toneInfo->size, length[head]);
 
-		for(CurWaveIndex = 0; CurWaveIndex < numWave+1; CurWaveIndex++) {
-			if(CurWaveIndex == numWave ) { /* play the last tone set*/
-				playingTime = waveRestPlayTime;
-			} else {
-				playingTime = MAX_DURATION;
-			}
-			duration = playingTime;
+		if (toneInfo->state != STATE_PLAY) {
+			stopped = 1;
+			break;
+		}
 
-			if(playingTime == 0) {
-				break;
-			}
+		if (length[head] < toneInfo->size)
+			length[head] = 0;
+		else
+			length[head] = _tone_cursor_fill(&cursor, toneInfo->volume,
+							(short*)(toneInfo->ring + head * toneInfo->size), period) * (SAMPLE_SIZE / 8);
 
-			if(prePlayingTime + playingTime > toneTime && toneTime != -1) {
-				playingTime = toneTime - prePlayingTime;
-			}
+		head = (head + 1) % toneInfo->ring_depth;
+	}
 
-			ptoneBuf = _create_tone (&sample, _TONE, toneInfo->volume, &toneSize);
-			if(ptoneBuf == NULL) {
-				debug_error("Tone Buffer is not allocated\n");
-				goto exit;
-			}
-			debug_log ("[TONE] Play.....%dth %dms\n", CurWaveIndex, playingTime);
-			avsys_audio_write(toneInfo->audio_handle, ptoneBuf, ((toneSize * playingTime /duration + 1)>>1)<<1);
-			prePlayingTime += playingTime;
-			debug_log ("previous_sum: %d\n", prePlayingTime);
-			g_free (ptoneBuf);
-			ptoneBuf = NULL;
-
-			if(prePlayingTime == toneTime || toneInfo->state != STATE_PLAY) {
-				debug_log ("Finished.....on Total Playing Time : %d _TONE.playing_time: %d\n", prePlayingTime, _TONE.playingTime);
-				avsys_audio_drain(toneInfo->audio_handle);
-				debug_log ("Finished.....quit loop\n");
-				goto exit;
-			}
+	debug_log ("Finished.....quit loop\n");
+	audio_handle = toneInfo->audio_handle;
+
+	if (stopped) {
+		/*
+		 * Stopped in the middle : the period following the last one written
+		 * goes out ramped down to silence for a few milliseconds, the slot is
+		 * released and the device is drained and closed by the close worker,
+		 * so this thread does not wait for the device either. Only locals are
+		 * used from here.
+		 */
+		head = (head + 1) % toneInfo->ring_depth;
+		fade = SAMPLERATE * TONE_FADE_OUT_MS / 1000;
+		if (fade > period)
+			fade = period;
+		if (toneInfo->ring_depth == 1)
+			length[head] = _tone_cursor_fill(&cursor, toneInfo->volume,
+							(short*)toneInfo->ring, fade) * (SAMPLE_SIZE / 8);
+		if (fade > length[head] / (SAMPLE_SIZE / 8))
+			fade = length[head] / (SAMPLE_SIZE / 8);
+		if (fade > 0) {
+			_tone_fade_out((short*)(toneInfo->ring + head * toneInfo->size), fade);
+			avsys_audio_write(audio_handle, toneInfo->ring + head * toneInfo->size, fade * (SAMPLE_SIZE / 8));
 		}
-		if(_mm_get_CurIndex(_TONE, &CurArrayPlayCnt, &CurIndex) != MM_ERROR_NONE) {
-			debug_error("_mm_get_CurIndex return value error\n");
-			goto exit;
+		debug_msg("Stopped, %d samples faded out, release the slot\n", fade);
+
+		pthread_mutex_lock(&toneInfo->control.syncker);
+		stop_time = toneInfo->stop_time;
+		toneInfo->state = STATE_STOP;
+		pthread_cond_signal(&toneInfo->control.cond);
+		pthread_mutex_unlock(&toneInfo->control.syncker);
+		if (toneInfo->stop_cb)
+		    toneInfo->stop_cb(toneInfo->cb_param);
+
+		_tone_close_deferred(audio_handle);
+		if (stop_time.tv_sec || stop_time.tv_nsec) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			debug_msg("Play thread released %ld us after the stop request\n",
+					(long)(now.tv_sec - stop_time.tv_sec) * 1000000L + (now.tv_nsec - stop_time.tv_nsec) / 1000);
 		}
+	} else {
+		_tone_close(audio_handle);
 
-		debug_log ("CurIndex: %d previous_sum: %d CurArrayPlayCnt: %d\n", CurIndex, prePlayingTime, CurArrayPlayCnt);
+		debug_msg("Play end\n");
+		_tone_set_state(toneInfo, STATE_STOP);
+		if (toneInfo->stop_cb)
+		    toneInfo->stop_cb(toneInfo->cb_param);
 	}
 
-exit :
-	result = avsys_audio_close(toneInfo->audio_handle);
-	if(AVSYS_FAIL(result))	{
-		debug_error("Device Close Error 0x%x\n", result);
-	}
-
-	pthread_mutex_destroy(&g_control.syncker);
-
-	debug_msg("Play end\n");
-	toneInfo->state = STATE_STOP;
-
-	if (toneInfo->stop_cb)
-	    toneInfo->stop_cb(toneInfo->cb_param);
-
 	debug_leave("\n");
 }
 
@@ -1109,7 +1745,11 @@ int MMSoundPlugCodecToneStop(MMHandleType handle)
 	tone_info_t *toneInfo = (tone_info_t*) handle;
 
 	debug_enter("(handle %x)\n", handle);
+	pthread_mutex_lock(&toneInfo->control.syncker);
+	clock_gettime(CLOCK_MONOTONIC, &toneInfo->stop_time);
 	toneInfo->state = STATE_STOP;
+	pthread_cond_signal(&toneInfo->control.cond);
+	pthread_mutex_unlock(&toneInfo->control.syncker);
 	debug_msg("sent stop signal\n");
 	debug_leave("\n");
 
@@ -1125,17 +1765,12 @@ int MMSoundPlugCodecToneSetThreadPool(int (*func)(void*, void (*)(void*)))
     return MM_ERROR_NONE;
 }
 
-static int _MMSoundToneInit(void)
-{
-	memset(&g_control, 0, sizeof(tone_control_t));
-	pthread_mutex_init(&g_control.syncker, NULL);
-	return MM_ERROR_NONE;
-}
-
-static int _MMSoundToneFini(void)
+__attribute__ ((destructor))
+static void _tone_pool_fini(void)
 {
-	pthread_mutex_destroy(&g_control.syncker);
-	return MM_ERROR_NONE;
+	mm_sound_pool_destroy(&g_tone_pool);
+	mm_sound_pool_destroy(&g_ring_pool);
+	mm_sound_pool_destroy(&g_plan_pool);
 }
 
 EXPORT_API
@@ -1151,6 +1786,8 @@ int MMSoundPlugCodecGetInterface(mmsound_codec_interface_t *intf)
 {
     debug_enter("\n");
 
+    pthread_once(&g_table_once, _tone_load_table);
+
     intf->GetSupportTypes   = MMSoundPlugCodecToneGetSupportTypes;
     intf->Parse             = MMSoundPlugCodecToneParse;
     intf->Create            = MMSoundPlugCodecToneCreate;
@@ -29,6 +29,7 @@
 #include <mm_error.h>
 #include <mm_debug.h>
 #include <pthread.h>
+#include <time.h>
 #include <avsys-audio.h>
 
 #include "../../include/mm_sound.h"
@@ -36,26 +37,12 @@
 #include "../../include/mm_sound_thread_pool.h"
 #include "../../include/mm_sound_plugin_codec.h"
 #include "../../../include/mm_sound_private.h"
+#include "../../../include/mm_sound_pool.h"
 
 
 #define SAMPLE_COUNT	128
-enum {
-	WAVE_CODE_UNKNOWN				= 0,
-	WAVE_CODE_PCM					= 1,
-	WAVE_CODE_ADPCM				= 2,
-	WAVE_CODE_G711					= 3,
-	WAVE_CODE_IMA_ADPCM				= 17,
-	WAVE_CODE_G723_ADPCM			= 20,
-	WAVE_CODE_GSM					= 49,
-	WAVE_CODE_G721_ADPCM			= 64,
-	WAVE_CODE_MPEG					= 80,
-};
-
-#define MAKE_FOURCC(a, b, c, d)		((a) | (b) << 8) | ((c) << 16 | ((d) << 24))
-#define RIFF_CHUNK_ID				((unsigned long) MAKE_FOURCC('R', 'I', 'F', 'F'))
-#define RIFF_CHUNK_TYPE				((unsigned long) MAKE_FOURCC('W', 'A', 'V', 'E'))
-#define FMT_CHUNK_ID				((unsigned long) MAKE_FOURCC('f', 'm', 't', ' '))
-#define DATA_CHUNK_ID				((unsigned long) MAKE_FOURCC('d', 'a', 't', 'a'))
+#define FADE_OUT_MS		5	/* ramp written after a stop instead of cutting the sound */
+#define CLOSE_QUEUE		8	/* stopped devices waiting for the close worker */
 
 enum {
    STATE_NONE = 0,
@@ -78,14 +65,238 @@ typedef struct
 	int (*stop_cb)(int);
 	int cb_param;
 	int state;
-	pthread_mutex_t mutex;
+	pthread_mutex_t mutex;	/* state changes, the play thread waits on cond for them */
+	pthread_cond_t cond;
+	int destroyed;		/* Destroy() came while the play thread ran, the thread frees the handle */
+	struct timespec stop_time;	/* Stop() request */
 	MMSourceType *source;
 	char buffer[48000 / 1000 * SAMPLE_COUNT * 2 *2];//segmentation fault when above 22.05KHz stereo
 	int handle_route;
+	mm_sound_wav_info_t wav;
+	int convert;		/* the device does not play the source format, write it as 16 bits */
+	char *loop_begin;	/* repeats go back here ... */
+	char *loop_end;		/* ... from here, the smpl loop or the whole data */
+	char *data_end;
 } wave_info_t;
 
+/* What is left to do on the device once a play is over */
+typedef struct
+{
+	avsys_handle_t audio_handle;
+	int handle_route;
+	int gain, out, in, option;	/* path before the play, restored after it */
+} wave_close_t;
+
+/* Devices of stopped plays, drained and closed by one worker so that the play thread goes back to the pool */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	wave_close_t queue[CLOSE_QUEUE];
+	int head;
+	int count;
+	int started;
+} g_closer = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, };
+
+/* Plays in progress, more than this many come from malloc() */
+#define WAVE_POOL_COUNT	8
+
+static mm_sound_pool_t g_wave_pool = MM_SOUND_POOL_INITIALIZER("wave info", sizeof(wave_info_t), WAVE_POOL_COUNT);
+
+/* Silence padding the last period of a play, shared by every play */
+static const char g_silence[sizeof(((wave_info_t *)0)->buffer)];
+
 static void _runing(void *param);
 
+/* Sets the state and wakes the play thread waiting for a change */
+static void _wave_set_state(wave_info_t *p, int state)
+{
+	pthread_mutex_lock(&p->mutex);
+	p->state = state;
+	pthread_cond_signal(&p->cond);
+	pthread_mutex_unlock(&p->mutex);
+}
+
+/* Puts 'size' bytes of the source at the cursor to 'dst', returns the bytes written */
+static int _wave_copy(wave_info_t *p, char *dst, int size)
+{
+	if (!p->convert) {
+		memcpy(dst, p->ptr_current, size);
+		return size;
+	}
+	return mm_sound_wav_to_s16(&p->wav, p->ptr_current, size / p->wav.block_align, (int16_t *)dst);
+}
+
+/*
+ * Fills the buffer with a period of the source. 'size' counts the bytes left
+ * to the loop end, then to the data end. When the loop end comes inside the
+ * period and repeats are left, the cursor goes back to the loop start and
+ * the period goes on from there, so repeats join sample to sample without
+ * silence or extra writes. Returns the bytes to write, less than a period
+ * only at the end of the play.
+ */
+static int _wave_fill(wave_info_t *p)
+{
+	int want = p->transper_size;
+	int nwrite = 0;
+	int nread;
+
+	while (want > 0) {
+		if (p->size == 0) {
+			if (p->ptr_current == p->loop_end && p->repeat_count != 0) {
+				if (p->repeat_count > 0)
+					p->repeat_count--;
+				p->ptr_current = p->loop_begin;
+				p->size = p->loop_end - p->loop_begin;
+			} else if (p->ptr_current < p->data_end) {
+				p->size = p->data_end - p->ptr_current;
+			} else {
+				break;
+			}
+		}
+		nread = p->size < want ? p->size : want;
+		nwrite += _wave_copy(p, p->buffer + nwrite, nread);
+		p->ptr_current += nread;
+		p->size -= nread;
+		want -= nread;
+	}
+
+	return nwrite;
+}
+
+/* Ramps the 'size' bytes written in the buffer down to silence, frame by frame */
+static void _wave_fade_out(wave_info_t *p, int size)
+{
+	int channels = p->wav.channels;
+	int frames, i, c;
+
+	if (p->convert || p->wav.bits == 16) {
+		int16_t *pcm = (int16_t *)p->buffer;
+
+		frames = size / (channels * (int)sizeof(int16_t));
+		for (i = 0; i < frames; i++)
+			for (c = 0; c < channels; c++)
+				pcm[i * channels + c] = pcm[i * channels + c] * (frames - 1 - i) / frames;
+	} else {
+		unsigned char *pcm = (unsigned char *)p->buffer;
+
+		frames = size / channels;
+		for (i = 0; i < frames; i++)
+			for (c = 0; c < channels; c++)
+				pcm[i * channels + c] = (pcm[i * channels + c] - 128) * (frames - 1 - i) / frames + 128;
+	}
+}
+
+static void _wave_free(wave_info_t *p)
+{
+	if(p->source) {
+		mm_source_close(p->source);
+		mm_source_free(p->source);
+	}
+
+	pthread_cond_destroy(&p->cond);
+	pthread_mutex_destroy(&p->mutex);
+	mm_sound_pool_free(&g_wave_pool, p);
+}
+
+/* Ends the play for the manager, which destroys the handle in the callback */
+static void _wave_finish(wave_info_t *p)
+{
+	int destroyed;
+
+	pthread_mutex_lock(&p->mutex);
+	p->audio_handle = -1;
+	p->state = STATE_NONE;
+	destroyed = p->destroyed;
+	pthread_mutex_unlock(&p->mutex);
+
+	if (destroyed) {
+		debug_msg("[CODEC WAV] Handle was destroyed during the play, free it\n");
+		_wave_free(p);
+		return;
+	}
+
+	if (p->stop_cb)
+	{
+		debug_msg("[CODEC WAV] Play is finished, Now start callback\n");
+		p->stop_cb(p->cb_param);
+	}
+}
+
+/* Drains the device, restores the path changed for the play and closes the device */
+static void _wave_close(const wave_close_t *c)
+{
+	int gain_after, out_after, in_after, option_after;
+	int ret;
+
+	if(AVSYS_FAIL(avsys_audio_drain(c->audio_handle)))
+	{
+		debug_error("avsys_audio_drain() failed\n");
+	}
+
+	/*
+	 * Restore path here
+	 */
+	if (c->handle_route == MM_SOUND_HANDLE_ROUTE_SPEAKER) {
+		avsys_audio_get_path_ex(&gain_after, &out_after, &in_after, &option_after);
+
+		/* If current path is not same as before playing sound, restore the sound path */
+		if (gain_after != c->gain || out_after != c->out || in_after != c->in || option_after != c->option) {
+
+			debug_msg("[CODEC WAV] Restore path to previous one\n");
+			ret = avsys_audio_set_path_ex(c->gain, c->out, c->in, c->option);
+			if(AVSYS_FAIL(ret)) {
+				debug_error("[CODEC WAV] Can not restore sound path\n");
+			}
+		}
+	}
+
+	ret = avsys_audio_close(c->audio_handle);
+	if (AVSYS_FAIL(ret)) {
+		debug_critical("[CODEC WAV] Can not close audio handle\n");
+	}
+}
+
+static void *_wave_closer(void *arg)
+{
+	wave_close_t c;
+
+	for (;;) {
+		pthread_mutex_lock(&g_closer.lock);
+		while (g_closer.count == 0)
+			pthread_cond_wait(&g_closer.cond, &g_closer.lock);
+		c = g_closer.queue[g_closer.head];
+		g_closer.head = (g_closer.head + 1) % CLOSE_QUEUE;
+		g_closer.count--;
+		pthread_mutex_unlock(&g_closer.lock);
+
+		_wave_close(&c);
+	}
+	return NULL;
+}
+
+/* Hands the close to the worker, started on first use. Closes in place when it cannot. */
+static void _wave_close_deferred(const wave_close_t *c)
+{
+	pthread_t thread;
+
+	pthread_mutex_lock(&g_closer.lock);
+	if (!g_closer.started && pthread_create(&thread, NULL, _wave_closer, NULL) == 0) {
+		pthread_detach(thread);
+		g_closer.started = 1;
+	}
+	if (g_closer.started && g_closer.count < CLOSE_QUEUE) {
+		g_closer.queue[(g_closer.head + g_closer.count) % CLOSE_QUEUE] = *c;
+		g_closer.count++;
+		pthread_cond_signal(&g_closer.cond);
+		pthread_mutex_unlock(&g_closer.lock);
+		return;
+	}
+	pthread_mutex_unlock(&g_closer.lock);
+
+	debug_warning("[CODEC WAV] close worker is not available, close in place\n");
+	_wave_close(c);
+}
+
 static int (*g_thread_pool_func)(void*, void (*)(void*)) = NULL;
 
 int MMSoundPlugCodecWaveSetThreadPool(int (*func)(void*, void (*)(void*)))
@@ -106,113 +317,35 @@ int* MMSoundPlugCodecWaveGetSupportTypes(void)
 
 int MMSoundPlugCodecWaveParse(MMSourceType *source, mmsound_codec_info_t *info)
 {
-	struct __riff_chunk
-	{
-		long chunkid;
-		long chunksize;
-		long rifftype;
-	};
-
-	struct __wave_chunk
-	{
-		long chunkid;
-		long chunksize;
-		unsigned short compression;
-		unsigned short channels;
-		unsigned long samplerate;
-		unsigned long avgbytepersec;
-		unsigned short blockkalign;
-		unsigned short bitspersample;
-	};
-
-	struct __data_chunk
-	{
-		long chunkid;
-		long chunkSize;
-	};
-
-	struct __riff_chunk *priff = NULL;
-	struct __wave_chunk *pwav = NULL;
-	struct __data_chunk *pdata = NULL;
-//	struct __fmt_chunk *pfmt = NULL;
-
-	int datalen = -1;
-	char *data = NULL;
-	unsigned int tSize;
+	mm_sound_wav_info_t *wav = &info->wav;
+	int ret;
 
 	debug_enter("\n");
 
-	data = MMSourceGetPtr(source);
-	debug_msg("[CODEC WAV] source ptr :[%p]\n", data);
-
-	datalen = MMSourceGetCurSize(source);
-	debug_msg("[CODEC WAV] source size :[0x%08X]\n", datalen);
-
-	priff = (struct __riff_chunk *) data;
-	
-	/* Must be checked, Just for wav or not */
-	if (priff->chunkid != RIFF_CHUNK_ID ||priff->rifftype != RIFF_CHUNK_TYPE)
-		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
-		
-	if(priff->chunksize != datalen -8)
-		priff->chunksize = (datalen-8);
-	
-	if (priff->chunkid != RIFF_CHUNK_ID ||priff->chunksize != datalen -8 ||priff->rifftype != RIFF_CHUNK_TYPE) {
-		debug_msg("[CODEC WAV] This contents is not RIFF file\n");
-		debug_msg("[CODEC WAV] cunkid : %ld, chunksize : %ld, rifftype : 0x%lx\n", priff->chunkid, priff->chunksize, priff->rifftype);
-		//debug_msg("[CODEC WAV] cunkid : %ld, chunksize : %d, rifftype : 0x%lx\n", RIFF_CHUNK_ID, datalen-8, RIFF_CHUNK_TYPE);
+	ret = mm_source_get_wav_info(source, wav);
+	if (ret != MM_ERROR_NONE) {
+		debug_msg("[CODEC WAV] This contents is not supported wave file\n");
 		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
 	}
-
-	debug_msg("[CODEC WAV] cunkid : %ld, chunksize : %ld, rifftype : 0x%lx\n", priff->chunkid, priff->chunksize, priff->rifftype);
-	//debug_msg("[CODEC WAV] cunkid : %ld, chunksize : %d, rifftype : 0x%lx\n", RIFF_CHUNK_ID, datalen-8, RIFF_CHUNK_TYPE);
-
-	tSize = sizeof(struct __riff_chunk);
-	pdata = (struct __data_chunk*)(data+tSize);
-		
-	while (pdata->chunkid != FMT_CHUNK_ID && tSize < datalen) {
-		tSize += (pdata->chunkSize+8);
-
-		if (tSize >= datalen) {
-			debug_warning("[CODEC WAV] Parsing finished : unable to find the Wave Format chunk\n");
-			return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
-		} else {
-			pdata = (struct __data_chunk*)(data+tSize);
-		}
+	if (wav->data_size == 0) {
+		debug_msg("[CODEC WAV] No PCM in the data chunk\n");
+		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
 	}
-	pwav = (struct __wave_chunk*)(data+tSize);
-
-	if (pwav->chunkid != FMT_CHUNK_ID ||
-	    pwav->compression != WAVE_CODE_PCM ||	/* Only supported PCM */
-	    pwav->avgbytepersec != pwav->samplerate * pwav->blockkalign ||
-	    pwav->blockkalign != (pwav->bitspersample >> 3)*pwav->channels) {
-		debug_msg("[CODEC WAV] This contents is not supported wave file\n");
-		debug_msg("[CODEC WAV] chunkid : 0x%lx, comp : 0x%x, av byte/sec : %lu, blockalign : %d\n", pwav->chunkid, pwav->compression, pwav->avgbytepersec, pwav->blockkalign);
+	if (wav->channels > 2) {
+		debug_msg("[CODEC WAV] %d channels are not supported\n", wav->channels);
 		return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
 	}
 
-	/* Only One data chunk support */
-
-	tSize += (pwav->chunksize+8);
-	pdata = (struct __data_chunk *)(data+tSize);
-
-	while (pdata->chunkid != DATA_CHUNK_ID && tSize < datalen) {
-		tSize += (pdata->chunkSize+8);
-		if (tSize >= datalen) {
-			debug_warning("[CODEC WAV] Parsing finished : unable to find the data chunk\n");
-			return MM_ERROR_SOUND_UNSUPPORTED_MEDIA_TYPE;
-		} else {
-			pdata = (struct __data_chunk*)(data+tSize);
-		}	
-	}
-	
 	info->codec = MM_SOUND_SUPPORTED_CODEC_WAVE;
-	info->channels = pwav->channels;
-	info->format = pwav->bitspersample;
-	info->samplerate = pwav->samplerate;
-	info->doffset = (tSize+8);
-	info->size = pdata->chunkSize;
-	debug_msg("info->size:%d\n", info->size);
+	info->channels = wav->channels;
+	info->format = wav->bits;
+	info->samplerate = wav->samplerate;
+	info->doffset = wav->data_offset;
+	info->size = wav->data_size;
+	debug_msg("[CODEC WAV] format 0x%x, %d bits (%d valid), %d ch, %d Hz, data %d bytes at %d\n",
+			wav->format, wav->bits, wav->valid_bits, wav->channels, wav->samplerate, info->size, info->doffset);
+	if (wav->loop_end)
+		debug_msg("[CODEC WAV] loop frames %u - %u\n", wav->loop_start, wav->loop_end);
 
 	debug_leave("\n");
 	return MM_ERROR_NONE;
@@ -256,7 +389,7 @@ int MMSoundPlugCodecWaveCreate(mmsound_codec_param_t *param, mmsound_codec_info_
 		return MM_ERROR_SOUND_INTERNAL;
 	}
 
-	p = (wave_info_t *) malloc(sizeof(wave_info_t));
+	p = (wave_info_t *) mm_sound_pool_alloc(&g_wave_pool, sizeof(wave_info_t));
 
 	if (p == NULL) {
 		debug_error("[CODEC WAV] memory allocation failed\n");
@@ -269,6 +402,14 @@ int MMSoundPlugCodecWaveCreate(mmsound_codec_param_t *param, mmsound_codec_info_
 	p->ptr_current = MMSourceGetPtr(source) + info->doffset;
 
 	p->size = info->size;
+	p->data_end = p->ptr_current + info->size;
+	if (info->wav.loop_end) {
+		p->loop_begin = p->ptr_current + info->wav.loop_start * info->wav.block_align;
+		p->loop_end = p->ptr_current + info->wav.loop_end * info->wav.block_align;
+	} else {
+		p->loop_begin = p->ptr_current;
+		p->loop_end = p->data_end;
+	}
 	p->transper_size = info->samplerate / 1000 * SAMPLE_COUNT * (info->format >> 3) * info->channels;
 
 	p->tone = param->tone;
@@ -276,7 +417,8 @@ int MMSoundPlugCodecWaveCreate(mmsound_codec_param_t *param, mmsound_codec_info_
 	p->stop_cb = param->stop_cb;
 	p->cb_param = param->param;
 	p->source = source;
-	//	pthread_mutex_init(&p->mutex, NULL);
+	p->wav = info->wav;
+	p->convert = !mm_sound_wav_is_native(&info->wav);
 
 	debug_msg("[CODEC WAV] transper_size : %d\n", p->transper_size);
 	debug_msg("[CODEC WAV] size : %d\n", p->size);
@@ -298,7 +440,7 @@ int MMSoundPlugCodecWaveCreate(mmsound_codec_param_t *param, mmsound_codec_info_
 	switch(info->format)
 	{
 	case 8:
-		audio_param.format =  AVSYS_AUDIO_FORMAT_8BIT;
+		audio_param.format =  p->convert ? AVSYS_AUDIO_FORMAT_16BIT : AVSYS_AUDIO_FORMAT_8BIT;
 		break;
 	case 16:
 		audio_param.format =  AVSYS_AUDIO_FORMAT_16BIT;
@@ -323,12 +465,13 @@ int MMSoundPlugCodecWaveCreate(mmsound_codec_param_t *param, mmsound_codec_info_
 
 	if (p->audio_handle == (avsys_handle_t)-1) {
 		debug_critical("[CODEC WAV] audio_handle is not created !! \n");
-		if (p)
-			free(p);
+		mm_sound_pool_free(&g_wave_pool, p);
 		return MM_ERROR_SOUND_INTERNAL;
 	}
 
 
+	pthread_mutex_init(&p->mutex, NULL);
+	pthread_cond_init(&p->cond, NULL);
 	p->state = STATE_READY;
 
 	g_thread_pool_func(p, _runing);
@@ -352,7 +495,7 @@ int MMSoundPlugCodecWavePlay(MMHandleType handle)
 		return MM_ERROR_END_OF_FILE;
 	}
 	debug_msg("[CODEC WAV] send start signal\n");
-	p->state = STATE_BEGIN;
+	_wave_set_state(p, STATE_BEGIN);
 
 	debug_leave("\n");
 
@@ -364,36 +507,41 @@ int MMSoundPlugCodecWavePlay(MMHandleType handle)
 static void _runing(void *param)
 {
 	wave_info_t *p = (wave_info_t*) param;
-	int nread = 0;
-	char *org_cur = NULL;
-	int org_size = 0;
-	int stop_size;
+	int nwrite = 0;
+	int written = 0;
+	int stopped;
 	char *dummy = NULL;
-	int ret;
+	wave_close_t device;
+	struct timespec stop_time = { 0, 0 }, now;
 
-	int gain, out, in, option;
-	int gain_after, out_after, in_after, option_after;
+	int gain = 0, out = 0, in = 0, option = 0;
 
 
 	debug_enter("[CODEC WAV] (Slot ID %d)\n", p->cb_param);
 
 	/* Set the thread schedule */
-	org_cur = p->ptr_current;
-	org_size = p->size;
-
-	dummy = malloc(p->period);
-	if(!dummy) {
-		debug_error("[CODEC WAV] not enough memory");
-		return;
+	if (p->period <= (int)sizeof(g_silence)) {
+		dummy = (char *)g_silence;
+	} else {
+		dummy = malloc(p->period);
+		if(!dummy) {
+			debug_error("[CODEC WAV] not enough memory");
+			return;
+		}
+		memset(dummy, 0, p->period);
 	}
-	memset(dummy, 0, p->period);
-	p->transper_size = p->period;
-	stop_size = org_size > p->period ? org_size : p->period;
+	/* Source bytes of a device period */
+	if (p->convert)
+		p->transper_size = p->period / (p->wav.channels * sizeof(int16_t)) * p->wav.block_align;
+	else
+		p->transper_size = p->period;
 
 	debug_msg("[CODEC WAV] Wait start signal\n");
 
-	while(p->state == STATE_READY)
-		usleep(4);
+	pthread_mutex_lock(&p->mutex);
+	while (p->state == STATE_READY)
+		pthread_cond_wait(&p->cond, &p->mutex);
+	pthread_mutex_unlock(&p->mutex);
 
 	/*
 	 * set path here
@@ -419,84 +567,90 @@ static void _runing(void *param)
 	debug_msg("[CODEC WAV] repeat : %d\n", p->repeat_count);
 	debug_msg("[CODEC WAV] transper_size : %d\n", p->transper_size);
 
+	pthread_mutex_lock(&p->mutex);
 	if (p->state != STATE_STOP) {
 		debug_msg("[CODEC WAV] Play start\n");
 		p->state = STATE_PLAY;
 	} else {
 		debug_warning ("[CODEC WAV] state is already STATE_STOP\n");
 	}
+	pthread_mutex_unlock(&p->mutex);
 
-	while (((p->repeat_count == -1)?(1):(p->repeat_count--)) && p->state == STATE_PLAY) {
-		while (p->state == STATE_PLAY && p->size > 0) {
-			if (p->size >= p->transper_size) {
-				nread = p->transper_size;
-				memcpy(p->buffer, p->ptr_current, nread);
-				avsys_audio_write(p->audio_handle, p->buffer, nread);
-				p->ptr_current += nread;
-				p->size -= nread;
-				debug_msg("[CODEC WAV] Playing, nRead_data : %d Size : %d \n", nread, p->size);
-			} else {
-				/* Write remain size */
-				nread = p->size;
-				memcpy(p->buffer, p->ptr_current, nread);
-				avsys_audio_write(p->audio_handle, p->buffer, nread);
-				avsys_audio_write(p->audio_handle, dummy, (p->transper_size-nread));
-				//avsys_audio_drain(p->audio_handle);
-				//debug_error("Drain is called\n");
-				p->ptr_current += nread;
-				p->size = 0;
-			}
+	/* The first pass runs to the loop end, _wave_fill() takes the other passes and the tail */
+	if (p->repeat_count == 0) {
+		p->size = 0;
+		p->ptr_current = p->data_end;
+	} else {
+		if (p->repeat_count > 0)
+			p->repeat_count--;
+		p->size = p->loop_end - p->ptr_current;
+	}
+
+	while (p->state == STATE_PLAY) {
+		nwrite = _wave_fill(p);
+		if (nwrite == 0)
+			break;
+		avsys_audio_write(p->audio_handle, p->buffer, nwrite);
+		written = 1;
+		mm_source_stream_advance(p->source, p->ptr_current);
+		debug_msg("[CODEC WAV] Playing, nWrite_data : %d Size : %d \n", nwrite, p->size);
+		if (p->size == 0 && p->ptr_current == p->data_end && p->repeat_count == 0) {
+			/* Last period, padded to the device period */
+			if (nwrite < p->period)
+				avsys_audio_write(p->audio_handle, dummy, (p->period-nwrite));
+			break;
 		}
-		p->ptr_current = org_cur;
-		p->size = org_size;
 	}
 
 	debug_msg("[CODEC WAV] End playing\n");
-	p->state = STATE_STOP;
+	stopped = (p->state == STATE_STOP && written);
+	_wave_set_state(p, STATE_STOP);
 
-	if (p->audio_handle == -1) {
-		usleep(200000);
-		debug_warning("[CODEC WAV] audio already unrealize !!\n");
-	} else {
-		//usleep(75000);
-
-		if(AVSYS_FAIL(avsys_audio_drain(p->audio_handle)))
-		{
-			debug_error("avsys_audio_drain() failed\n");
-		}
+	device.audio_handle = p->audio_handle;
+	device.handle_route = p->handle_route;
+	device.gain = gain;
+	device.out = out;
+	device.in = in;
+	device.option = option;
 
+	if (stopped) {
 		/*
-		 * Restore path here
+		 * Stopped in the middle : the next few milliseconds of the sound go
+		 * out ramped down to silence, the slot is released and the device is
+		 * drained and closed by the close worker, so this thread does not
+		 * wait for the device either. Only locals are used from here.
 		 */
-		if (p->handle_route == MM_SOUND_HANDLE_ROUTE_SPEAKER) {
-			avsys_audio_get_path_ex(&gain_after, &out_after, &in_after, &option_after);
-
-			/* If current path is not same as before playing sound, restore the sound path */
-			if (gain_after != gain || out_after != out || in_after != in || option_after != option) {
-
-				debug_msg("[CODEC WAV] Restore path to previous one\n");
-				ret = avsys_audio_set_path_ex(gain, out, in, option);
-				if(AVSYS_FAIL(ret)) {
-					debug_error("[CODEC WAV] Can not restore sound path\n");
-				}
-			}
-		}
-
-		ret = avsys_audio_close(p->audio_handle);
-		if (AVSYS_FAIL(ret)) {
-			debug_critical("[CODEC WAV] Can not close audio handle\n");
+		p->transper_size = p->wav.samplerate * FADE_OUT_MS / 1000 * p->wav.block_align;
+		nwrite = _wave_fill(p);
+		if (nwrite > 0) {
+			_wave_fade_out(p, nwrite);
+			avsys_audio_write(device.audio_handle, p->buffer, nwrite);
 		}
-
+		debug_msg("[CODEC WAV] Stopped, %d bytes faded out, release the slot\n", nwrite);
+		pthread_mutex_lock(&p->mutex);
+		stop_time = p->stop_time;
+		pthread_mutex_unlock(&p->mutex);
+		_wave_finish(p);
 	}
-	p->audio_handle = -1;
 
-	p->state = STATE_NONE;
+	if (device.audio_handle == -1) {
+		debug_warning("[CODEC WAV] audio already unrealize !!\n");
+	} else if (stopped) {
+		_wave_close_deferred(&device);
+	} else {
+		_wave_close(&device);
+	}
 
-	free(dummy);
-	if (p->stop_cb)
-	{
-		debug_msg("[CODEC WAV] Play is finished, Now start callback\n");
-		p->stop_cb(p->cb_param);
+	if (dummy != g_silence)
+		free(dummy);
+	if (stopped) {
+		if (stop_time.tv_sec || stop_time.tv_nsec) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			debug_msg("[CODEC WAV] Play thread released %ld us after the stop request\n",
+					(long)(now.tv_sec - stop_time.tv_sec) * 1000000L + (now.tv_nsec - stop_time.tv_nsec) / 1000);
+		}
+	} else {
+		_wave_finish(p);
 	}
 	debug_leave("\n");
 }
@@ -512,7 +666,11 @@ int MMSoundPlugCodecWaveStop(MMHandleType handle)
 	debug_msg("[CODEC WAV] Current state is state %d\n", p->state);
 	debug_msg("[CODEC WAV] Handle 0x%08X stop requested\n", handle);
 
+	pthread_mutex_lock(&p->mutex);
+	clock_gettime(CLOCK_MONOTONIC, &p->stop_time);
 	p->state = STATE_STOP;
+	pthread_cond_signal(&p->cond);
+	pthread_mutex_unlock(&p->mutex);
 
     return MM_ERROR_NONE;
 }
@@ -526,16 +684,31 @@ int MMSoundPlugCodecWaveDestroy(MMHandleType handle)
 		return MM_ERROR_SOUND_INVALID_POINTER;
 	}
 
-	if(p->source) {
-		mm_source_close(p->source);
-		free(p->source);
+	/*
+	 * The play thread is still running when Play failed or was never called :
+	 * stop it and let it free the handle on its way out.
+	 */
+	pthread_mutex_lock(&p->mutex);
+	if (p->state != STATE_NONE) {
+		p->destroyed = 1;
+		p->state = STATE_STOP;
+		pthread_cond_signal(&p->cond);
+		pthread_mutex_unlock(&p->mutex);
+		return MM_ERROR_NONE;
 	}
+	pthread_mutex_unlock(&p->mutex);
 
-	free(p);
+	_wave_free(p);
 
 	return MM_ERROR_NONE;
 }
 
+__attribute__ ((destructor))
+static void _wave_pool_fini(void)
+{
+	mm_sound_pool_destroy(&g_wave_pool);
+}
+
 EXPORT_API
 int MMSoundGetPluginType(void)
 {
@@ -30,6 +30,7 @@
 #define MIN_TONE_PLAY_TIME 300
 #include "../include/mm_sound.h"
 #include "../include/mm_sound_private.h"
+#include "../include/mm_sound_keytone.h"
 
 #include <glib.h>
 
@@ -39,6 +40,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <vconf.h>
 #include <mm_session_private.h>
 #include <audio-session-manager-types.h>
@@ -116,7 +118,14 @@ static void displaymenu()
 		g_print("c : play sound ex \t");
 		g_print("F : Play DTMF     \t");
 		g_print("b : Play directory\n");
-		g_print("s : Stop play     \n");
+		g_print("s : Stop play     \t");
+		g_print("M : Play metronome\n");
+		g_print("K : Key Sound (ID)\t");
+		g_print("L : Keytone latency\n");
+		g_print("J : Two key sounds in one pipe write (two voices)\n");
+		g_print("B <name> : Play <name> of the bank set by 'f'\n");
+		g_print("N : Tone sequence looping on empty segments (rejected)\n");
+		g_print("P : Preload a pack of the files in the directory set by 'd' (at least 64)\n");
 		g_print("==================================================================\n");
 		g_print("	Volume APIs\n");
 		g_print("==================================================================\n");
@@ -213,6 +222,78 @@ static void interpret (char *cmd)
 				if(ret < 0)
 					debug_log("keysound play failed with 0x%x\n", ret);
 			}
+			else if(strncmp(cmd, "L", 1) == 0)
+			{
+				static const char *span_name[MM_SOUND_KEYTONE_SPAN_MAX] = {"pipe", "open", "parse", "handle", "write", "total"};
+				mm_sound_keytone_stats_t stats;
+				int span, bucket;
+				ret = mm_sound_get_keytone_stats(&stats);
+				if(ret < 0) {
+					debug_log("get keytone stats failed with 0x%x\n", ret);
+				} else {
+					g_print("presses %u, opens %u, closes %u, keep-alive %u ms, interval %u ms\n",
+							stats.presses, stats.opens, stats.closes, stats.keepalive_ms, stats.interval_ms);
+					g_print("dropped %u, merged %u\n", stats.dropped, stats.merged);
+					for(span = 0; span < MM_SOUND_KEYTONE_SPAN_MAX; span++) {
+						g_print("%-7s:", span_name[span]);
+						for(bucket = 0; bucket < MM_SOUND_KEYTONE_HIST_BUCKETS; bucket++)
+							g_print(" %u", stats.histogram[span][bucket]);
+						g_print("\n");
+					}
+				}
+			}
+			else if(strncmp(cmd, "J", 1) == 0)
+			{
+				/* Both presses arrive in one read of the server, each must get its own voice */
+				char buf[2 * (sizeof(mm_sound_keytone_ipc_t) + sizeof(POWERON_FILE))];
+				mm_sound_keytone_ipc_t record = {0,};
+				mm_sound_keytone_stats_t before, after;
+				int len = 0, i, fd;
+
+				record.version = KEYTONE_IPC_VERSION;
+				record.flags = KEYTONE_FLAG_PATH;
+				record.length = strlen(POWERON_FILE);
+				record.keytone_id = KEYTONE_ID_NONE;
+				record.vol_type = 8;
+				for(i = 0; i < 2; i++) {
+					memcpy(buf + len, &record, sizeof(record));
+					len += sizeof(record);
+					memcpy(buf + len, POWERON_FILE, record.length);
+					len += record.length;
+				}
+
+				fd = open(KEYTONE_PATH, O_WRONLY | O_NONBLOCK);
+				if(fd == -1 || mm_sound_get_keytone_stats(&before) < 0) {
+					debug_log("keytone pipe or stats are not available\n");
+				} else {
+					if(write(fd, buf, len) != len)
+						debug_log("keytone pipe write failed\n");
+					/* longer than the flood limit, which may hold the second press back */
+					usleep(500000);
+					if(mm_sound_get_keytone_stats(&after) < 0)
+						debug_log("get keytone stats failed\n");
+					else
+						g_print("two presses in one write : %u played, %u merged, %u dropped -> %s\n",
+								after.presses - before.presses, after.merged - before.merged, after.dropped - before.dropped,
+								after.presses - before.presses == 2 ? "OK" : "FAIL");
+				}
+				if(fd != -1)
+					close(fd);
+			}
+			else if(strncmp(cmd, "K", 1) == 0)
+			{
+				static int keytone_id = -1;
+				if(keytone_id == -1) {
+					ret = mm_sound_keysound_register(POWERON_FILE, &keytone_id);
+					if(ret < 0)
+						debug_log("keysound register failed with 0x%x\n", ret);
+				}
+				if(keytone_id != -1) {
+					ret = mm_sound_play_keysound_id(keytone_id, 8);
+					if(ret < 0)
+						debug_log("keysound play failed with 0x%x\n", ret);
+				}
+			}
 			else if(strncmp(cmd, "q", 1) == 0)
 			{//get media volume
 				unsigned int value = 100;
@@ -326,6 +407,13 @@ static void interpret (char *cmd)
 				if(ret < 0)
 					debug_log("mm_sound_play_sound() failed with 0x%x\n", ret);
 			}
+			else if(strncmp(cmd, "B", 1) == 0)
+			{
+				char *name = g_strstrip(cmd + 1);
+				ret = mm_sound_play_sound_bank(g_file_name, name, g_volume_type, mycallback ,"USERDATA", &handle);
+				if(ret < 0)
+					debug_log("mm_sound_play_sound_bank() failed with 0x%x\n", ret);
+			}
 			else if(strncmp(cmd, "A", 1) == 0)
 			{
 				debug_log("volume is %d type, %d\n", g_volume_type, g_volume_value);
@@ -449,6 +537,35 @@ static void interpret (char *cmd)
 						debug_log ("[magpie] Play DTMF sound cannot be played ! %d\n", handle);
 				}
 			}
+			else if(strncmp(cmd, "M", 1) == 0)
+			{
+				/* accented first beat of a 4/4 bar at 120 bpm */
+				MMSoundToneSegment_t bar[] = {
+					{ 1500, 0, 0, 30, 0, 0 },
+					{ 0, 0, 0, 470, 0, 0 },
+					{ 1000, 0, 0, 30, 0, 0 },
+					{ 0, 0, 0, 470, 2, 2 },
+				};
+
+				ret = mm_sound_play_tone_sequence(bar, sizeof(bar) / sizeof(bar[0]), VOLUME_TYPE_SYSTEM, 1.0, 8000, &handle);
+				if(ret < 0)
+					debug_log("Play tone sequence failed %x\n", ret);
+			}
+			else if(strncmp(cmd, "N", 1) == 0)
+			{
+				/* the loop goes back over zero length segments only, the server must refuse it */
+				MMSoundToneSegment_t empty_loop[] = {
+					{ 1000, 0, 0, 100, 0, 0 },
+					{ 0, 0, 0, 0, 1, 1 },
+					{ 0, 0, 0, 0, 3, 1 },
+				};
+
+				ret = mm_sound_play_tone_sequence(empty_loop, sizeof(empty_loop) / sizeof(empty_loop[0]), VOLUME_TYPE_SYSTEM, 1.0, 1000, &handle);
+				if(ret < 0)
+					debug_log("Tone sequence rejected as expected %x\n", ret);
+				else
+					debug_log("Tone sequence with an empty loop was accepted, handle %d\n", handle);
+			}
 			else if (strncmp (cmd, "b",1) == 0)
 			{
 				DIR	*basedir;
@@ -518,6 +635,61 @@ static void interpret (char *cmd)
 				}
 
 			}
+			else if (strncmp (cmd, "P",1) == 0)
+			{
+				/* More files than the pinned set holds, the directory is topped up with the power on sound */
+				const int min_count = 64;
+				static char names[MM_SOUND_PRELOAD_PACK_MAX][MAX_PATH_LEN];
+				static const char *filenames[MM_SOUND_PRELOAD_PACK_MAX];
+				static mm_sound_preload_status_t status[MM_SOUND_PRELOAD_PACK_MAX];
+				unsigned long long bytes = 0;
+				unsigned int last_us = 0;
+				int count = 0, failed = 0, i;
+				DIR	*basedir;
+				struct dirent *entry;
+				struct stat file_stat;
+
+				if(g_dir_name[strlen(g_dir_name)-1] == '/')
+					g_dir_name[strlen(g_dir_name)-1] = '\0';
+
+				basedir = opendir(g_dir_name);
+				if(basedir != NULL)
+				{
+					while((entry = readdir(basedir)) != NULL && count < MM_SOUND_PRELOAD_PACK_MAX)
+					{
+						if(entry->d_name[0] == '.')
+							continue;
+						snprintf(names[count], MAX_PATH_LEN, "%s/%s", g_dir_name, entry->d_name);
+						if(lstat(names[count], &file_stat) == 0 && S_ISREG(file_stat.st_mode))
+							count++;
+					}
+					closedir(basedir);
+				}
+				else
+				{
+					debug_log("Cannot Open such a directory %s, preload the power on sound only\n", g_dir_name);
+				}
+				while(count < min_count)
+					strncpy(names[count++], POWERON_FILE, MAX_PATH_LEN-1);
+				for(i = 0; i < count; i++)
+					filenames[i] = names[i];
+
+				ret = mm_sound_preload_pack(filenames, count, status);
+				if(ret < 0) {
+					debug_log("preload pack failed with 0x%x\n", ret);
+				} else {
+					for(i = 0; i < count; i++) {
+						g_print("%4d %-60s 0x%08x %8u bytes %8u us\n", i, filenames[i],
+								status[i].result, status[i].size, status[i].elapsed_us);
+						if(status[i].result != MM_ERROR_NONE)
+							failed++;
+						bytes += status[i].size;
+						if(status[i].elapsed_us > last_us)
+							last_us = status[i].elapsed_us;
+					}
+					g_print("preloaded %d files, %d failed, %llu bytes in %u us\n", count - failed, failed, bytes, last_us);
+				}
+			}
 
 		else if (strncmp (cmd, "c",1) == 0)
 		{
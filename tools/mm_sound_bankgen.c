@@ -0,0 +1,438 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * mm_sound_bankgen : packs the WAV files of a directory into a sound bank
+ *
+ * usage : mm_sound_bankgen [-r samplerate] <directory> <bank>
+ *
+ * Every sound is converted to 16 bits PCM at the device rate (44100 Hz unless
+ * -r is given) and named after its file, without the ".wav" extension.
+ * Sources may be 8 to 32 bits integer or float PCM, mono or stereo.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <dirent.h>
+#include <stddef.h>
+
+#include <mm_error.h>
+
+#include "mm_sound_bank.h"
+#include "mm_sound_wav.h"
+
+#define DEFAULT_SAMPLERATE	44100
+#define MAX_SAMPLERATE		192000
+#define MAX_SOUND			65536
+
+typedef struct {
+	char name[MM_SOUND_BANK_NAME_MAX];
+	int16_t *pcm;
+	uint32_t frames;
+	uint16_t channels;
+	uint32_t samplerate;
+} sound_t;
+
+typedef struct {
+	sound_t *sounds;
+	int count;
+	int alloc;
+} bank_t;
+
+static void _put_le32(unsigned char *p, uint32_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
+
+static void _put_le16(unsigned char *p, uint16_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+}
+
+static int _host_is_le(void)
+{
+	const uint16_t one = 1;
+
+	return *(const unsigned char *)&one;
+}
+
+static int _write_header(FILE *fp, const mm_sound_bank_header_t *header)
+{
+	unsigned char buf[sizeof(mm_sound_bank_header_t)];
+
+	memset(buf, 0, sizeof(buf));
+	_put_le32(buf + offsetof(mm_sound_bank_header_t, magic), header->magic);
+	_put_le16(buf + offsetof(mm_sound_bank_header_t, version), header->version);
+	_put_le16(buf + offsetof(mm_sound_bank_header_t, align), header->align);
+	_put_le32(buf + offsetof(mm_sound_bank_header_t, count), header->count);
+	_put_le32(buf + offsetof(mm_sound_bank_header_t, index_offset), header->index_offset);
+	_put_le32(buf + offsetof(mm_sound_bank_header_t, names_offset), header->names_offset);
+	_put_le32(buf + offsetof(mm_sound_bank_header_t, data_offset), header->data_offset);
+	_put_le32(buf + offsetof(mm_sound_bank_header_t, file_size), header->file_size);
+	_put_le32(buf + offsetof(mm_sound_bank_header_t, reserved), header->reserved);
+
+	return fwrite(buf, sizeof(buf), 1, fp) == 1 ? 0 : -1;
+}
+
+static int _write_entry(FILE *fp, const mm_sound_bank_entry_t *entry)
+{
+	unsigned char buf[sizeof(mm_sound_bank_entry_t)];
+
+	memset(buf, 0, sizeof(buf));
+	_put_le32(buf + offsetof(mm_sound_bank_entry_t, hash), entry->hash);
+	_put_le32(buf + offsetof(mm_sound_bank_entry_t, name_offset), entry->name_offset);
+	_put_le32(buf + offsetof(mm_sound_bank_entry_t, offset), entry->offset);
+	_put_le32(buf + offsetof(mm_sound_bank_entry_t, size), entry->size);
+	_put_le32(buf + offsetof(mm_sound_bank_entry_t, samplerate), entry->samplerate);
+	_put_le16(buf + offsetof(mm_sound_bank_entry_t, channels), entry->channels);
+	_put_le16(buf + offsetof(mm_sound_bank_entry_t, bits), entry->bits);
+
+	return fwrite(buf, sizeof(buf), 1, fp) == 1 ? 0 : -1;
+}
+
+/* 16 bits PCM, little endian whatever the host is */
+static int _write_pcm(FILE *fp, const int16_t *pcm, uint32_t samples)
+{
+	unsigned char buf[4096];
+	uint32_t i, n;
+
+	if (_host_is_le())
+		return fwrite(pcm, sizeof(int16_t), samples, fp) == samples ? 0 : -1;
+
+	while (samples > 0) {
+		n = samples < sizeof(buf) / 2 ? samples : sizeof(buf) / 2;
+		for (i = 0; i < n; i++)
+			_put_le16(buf + i * 2, (uint16_t)pcm[i]);
+		if (fwrite(buf, 2, n, fp) != n)
+			return -1;
+		pcm += n;
+		samples -= n;
+	}
+	return 0;
+}
+
+static unsigned char *_read_file(const char *path, long *size)
+{
+	FILE *fp = fopen(path, "rb");
+	unsigned char *buf = NULL;
+
+	if (fp == NULL)
+		return NULL;
+	if (fseek(fp, 0, SEEK_END) == 0 && (*size = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+		buf = malloc(*size);
+		if (buf && fread(buf, 1, *size, fp) != (size_t)*size) {
+			free(buf);
+			buf = NULL;
+		}
+	}
+	fclose(fp);
+	return buf;
+}
+
+static int _load_wav(const char *path, int samplerate, sound_t *sound)
+{
+	mm_sound_wav_info_t wav;
+	unsigned char *buf;
+	int16_t *in = NULL;
+	uint32_t frames, in_frames, i, c;
+	long size = 0;
+	int ret = -1;
+
+	buf = _read_file(path, &size);
+	if (buf == NULL) {
+		fprintf(stderr, "%s: %s\n", path, errno ? strerror(errno) : "empty file");
+		return -1;
+	}
+
+	if (size > UINT32_MAX || mm_sound_wav_index(buf, size, &wav) != MM_ERROR_NONE || wav.channels > 2) {
+		fprintf(stderr, "%s: only mono/stereo PCM or float WAV is supported\n", path);
+		goto out;
+	}
+
+	in_frames = wav.data_size / wav.block_align;
+	if (in_frames == 0) {
+		fprintf(stderr, "%s: no sample\n", path);
+		goto out;
+	}
+	frames = (uint32_t)(((uint64_t)in_frames * samplerate + wav.samplerate - 1) / wav.samplerate);
+	in = malloc((size_t)in_frames * wav.channels * sizeof(int16_t));
+	sound->pcm = malloc((size_t)frames * wav.channels * sizeof(int16_t));
+	if (in == NULL || sound->pcm == NULL) {
+		fprintf(stderr, "out of memory\n");
+		goto out;
+	}
+	mm_sound_wav_to_s16(&wav, buf + wav.data_offset, in_frames, in);
+
+	/* Linear interpolation between the two nearest input frames */
+	for (i = 0; i < frames; i++) {
+		uint64_t pos_q16 = ((uint64_t)i * wav.samplerate << 16) / samplerate;
+		uint32_t index = pos_q16 >> 16;
+		uint32_t frac = pos_q16 & 0xffff;
+		uint32_t next = (index + 1 < in_frames) ? index + 1 : index;
+
+		for (c = 0; c < wav.channels; c++) {
+			int32_t a = in[index * wav.channels + c];
+			int32_t b = in[next * wav.channels + c];
+
+			sound->pcm[i * wav.channels + c] = (int16_t)(a + (((b - a) * (int32_t)frac) >> 16));
+		}
+	}
+	sound->frames = frames;
+	sound->channels = wav.channels;
+	sound->samplerate = samplerate;
+	ret = 0;
+
+out:
+	free(in);
+	free(buf);
+	return ret;
+}
+
+static int _scan(const char *dirname, int samplerate, bank_t *bank)
+{
+	DIR *dir = opendir(dirname);
+	struct dirent *ent;
+	char path[4096];
+	size_t length;
+	int ret = 0;
+
+	if (dir == NULL) {
+		fprintf(stderr, "%s: %s\n", dirname, strerror(errno));
+		return -1;
+	}
+
+	while ((ent = readdir(dir)) != NULL) {
+		length = strlen(ent->d_name);
+		if (length <= 4 || strcasecmp(ent->d_name + length - 4, ".wav") != 0)
+			continue;
+		if (length - 4 >= MM_SOUND_BANK_NAME_MAX) {
+			fprintf(stderr, "%s: name is longer than %d\n", ent->d_name, MM_SOUND_BANK_NAME_MAX - 1);
+			ret = -1;
+			break;
+		}
+		if (bank->count == bank->alloc) {
+			int alloc = bank->alloc ? bank->alloc * 2 : 64;
+			sound_t *sounds;
+
+			if (alloc > MAX_SOUND || (sounds = realloc(bank->sounds, alloc * sizeof(sound_t))) == NULL) {
+				fprintf(stderr, "too many sounds\n");
+				ret = -1;
+				break;
+			}
+			bank->sounds = sounds;
+			bank->alloc = alloc;
+		}
+		snprintf(path, sizeof(path), "%s/%s", dirname, ent->d_name);
+
+		memset(&bank->sounds[bank->count], 0, sizeof(sound_t));
+		memcpy(bank->sounds[bank->count].name, ent->d_name, length - 4);
+		if (_load_wav(path, samplerate, &bank->sounds[bank->count]) < 0) {
+			ret = -1;
+			break;
+		}
+		bank->count++;
+	}
+
+	closedir(dir);
+	return ret;
+}
+
+static int _compare(const void *a, const void *b)
+{
+	const sound_t *sa = a, *sb = b;
+	uint32_t ha = mm_sound_bank_hash(sa->name);
+	uint32_t hb = mm_sound_bank_hash(sb->name);
+
+	if (ha != hb)
+		return ha < hb ? -1 : 1;
+	return strcmp(sa->name, sb->name);
+}
+
+static int _pad(FILE *fp, uint64_t *pos, uint64_t to)
+{
+	static const char zero[MM_SOUND_BANK_ALIGN];
+
+	while (*pos < to) {
+		size_t n = (to - *pos > sizeof(zero)) ? sizeof(zero) : (size_t)(to - *pos);
+
+		if (fwrite(zero, 1, n, fp) != n)
+			return -1;
+		*pos += n;
+	}
+	return 0;
+}
+
+static int _write(FILE *fp, bank_t *bank)
+{
+	mm_sound_bank_header_t header;
+	mm_sound_bank_entry_t *index;
+	unsigned char wav[MM_SOUND_BANK_WAV_HEADER];
+	uint64_t pos, names_size = 0, offset;
+	uint32_t pcm_size;
+	int i, ret = -1;
+
+	index = calloc(bank->count, sizeof(mm_sound_bank_entry_t));
+	if (index == NULL)
+		return -1;
+
+	for (i = 0; i < bank->count; i++)
+		names_size += strlen(bank->sounds[i].name) + 1;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = MM_SOUND_BANK_MAGIC;
+	header.version = MM_SOUND_BANK_VERSION;
+	header.align = MM_SOUND_BANK_ALIGN;
+	header.count = bank->count;
+	header.index_offset = sizeof(header);
+	header.names_offset = header.index_offset + bank->count * sizeof(mm_sound_bank_entry_t);
+	offset = header.names_offset + names_size;
+	header.data_offset = offset;
+
+	/* The WAV header goes right before the aligned PCM */
+	names_size = header.names_offset;
+	for (i = 0; i < bank->count; i++) {
+		sound_t *sound = &bank->sounds[i];
+
+		pcm_size = sound->frames * sound->channels * sizeof(int16_t);
+		offset = ((offset + MM_SOUND_BANK_WAV_HEADER + MM_SOUND_BANK_ALIGN - 1) & ~(uint64_t)(MM_SOUND_BANK_ALIGN - 1)) - MM_SOUND_BANK_WAV_HEADER;
+		index[i].hash = mm_sound_bank_hash(sound->name);
+		index[i].name_offset = names_size;
+		index[i].offset = offset;
+		index[i].size = MM_SOUND_BANK_WAV_HEADER + pcm_size;
+		index[i].samplerate = sound->samplerate;
+		index[i].channels = sound->channels;
+		index[i].bits = 16;
+		names_size += strlen(sound->name) + 1;
+		offset += index[i].size;
+		if (offset > UINT32_MAX) {
+			fprintf(stderr, "bank is bigger than 4GB\n");
+			goto out;
+		}
+	}
+	header.file_size = offset;
+
+	if (_write_header(fp, &header) < 0)
+		goto out;
+	for (i = 0; i < bank->count; i++) {
+		if (_write_entry(fp, &index[i]) < 0)
+			goto out;
+	}
+	for (i = 0; i < bank->count; i++) {
+		if (fwrite(bank->sounds[i].name, strlen(bank->sounds[i].name) + 1, 1, fp) != 1)
+			goto out;
+	}
+
+	pos = header.data_offset;
+	for (i = 0; i < bank->count; i++) {
+		sound_t *sound = &bank->sounds[i];
+
+		pcm_size = index[i].size - MM_SOUND_BANK_WAV_HEADER;
+		memcpy(wav, "RIFF", 4);
+		_put_le32(wav + 4, index[i].size - 8);
+		memcpy(wav + 8, "WAVEfmt ", 8);
+		_put_le32(wav + 16, 16);
+		_put_le16(wav + 20, 1);
+		_put_le16(wav + 22, sound->channels);
+		_put_le32(wav + 24, sound->samplerate);
+		_put_le32(wav + 28, sound->samplerate * sound->channels * 2);
+		_put_le16(wav + 32, sound->channels * 2);
+		_put_le16(wav + 34, 16);
+		memcpy(wav + 36, "data", 4);
+		_put_le32(wav + 40, pcm_size);
+
+		if (_pad(fp, &pos, index[i].offset) < 0 ||
+			fwrite(wav, sizeof(wav), 1, fp) != 1 ||
+			_write_pcm(fp, sound->pcm, pcm_size / sizeof(int16_t)) < 0)
+			goto out;
+		pos += index[i].size;
+	}
+	ret = 0;
+
+out:
+	free(index);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	static bank_t bank;
+	FILE *out = NULL;
+	int samplerate = DEFAULT_SAMPLERATE;
+	int argi = 1;
+	int ret = 1;
+	int i;
+
+	if (argc == 5 && strcmp(argv[1], "-r") == 0) {
+		samplerate = atoi(argv[2]);
+		argi = 3;
+	}
+	if (argc - argi != 2 || samplerate <= 0 || samplerate > MAX_SAMPLERATE) {
+		fprintf(stderr, "usage : %s [-r samplerate] <directory> <bank>\n", argv[0]);
+		return 1;
+	}
+
+	if (_scan(argv[argi], samplerate, &bank) < 0)
+		goto cleanup;
+	if (bank.count == 0) {
+		fprintf(stderr, "%s: no WAV file\n", argv[argi]);
+		goto cleanup;
+	}
+
+	qsort(bank.sounds, bank.count, sizeof(sound_t), _compare);
+	for (i = 1; i < bank.count; i++) {
+		if (strcmp(bank.sounds[i - 1].name, bank.sounds[i].name) == 0) {
+			fprintf(stderr, "%s: sound [%s] is defined twice\n", argv[argi], bank.sounds[i].name);
+			goto cleanup;
+		}
+	}
+
+	out = fopen(argv[argi + 1], "wb");
+	if (out == NULL) {
+		fprintf(stderr, "%s: %s\n", argv[argi + 1], strerror(errno));
+		goto cleanup;
+	}
+
+	if (_write(out, &bank) < 0 || fclose(out) != 0) {
+		out = NULL;
+		fprintf(stderr, "%s: write failed\n", argv[argi + 1]);
+		remove(argv[argi + 1]);
+		goto cleanup;
+	}
+	out = NULL;
+
+	printf("%s: %d sounds at %d Hz\n", argv[argi + 1], bank.count, samplerate);
+	ret = 0;
+
+cleanup:
+	if (out)
+		fclose(out);
+	for (i = 0; i < bank.count; i++)
+		free(bank.sounds[i].pcm);
+	free(bank.sounds);
+	return ret;
+}
@@ -0,0 +1,190 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * mm_sound_tonebench : measures the tone renderer against the sin() one it replaced
+ *
+ * usage : mm_sound_tonebench [-n seconds]
+ *
+ * Every tone below is rendered for 'seconds' of audio, in device sized chunks,
+ * by the wavetable oscillator of the tone plugin and by the per sample sin()
+ * sum of the former _create_tone(). The output of both is compared sample by
+ * sample.
+ *
+ * Then every built-in tone is compiled twice, the way a play request does :
+ * the first compile renders the loops the tone misses in the cache, the
+ * second one only looks them up. The arena used by the loops is reported.
+ */
+
+#include <math.h>
+
+/* The renderer is static in the plugin, build it in */
+#include "../server/plugin/tone/mm_sound_plugin_codec_tone.c"
+
+#define DEFAULT_SECONDS	60
+#define BENCH_CHUNK		1024	/* samples rendered at once, a device period */
+
+typedef struct {
+	const char *name;
+	TONE tone;
+} bench_tone_t;
+
+static const bench_tone_t g_bench_tones[] = {
+	{ "1000 Hz",		{ 1000, 0, 0, -1, 0, 0 } },
+	{ "DTMF 1",			{ 697, 1209, 0, -1, 0, 0 } },
+	{ "3 partials",		{ 440, 880, 1320, -1, 0, 0 } },
+};
+
+static long long _now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* The former renderer : a sin() per partial and sample, from a running sample counter */
+static void _sin_render(double *sample, const TONE *_TONE, double volume, short *out, int count)
+{
+	double f1, f2, f3, amplitude;
+	int quota = 0;
+	int i;
+
+	if (_TONE->low_frequency > 0)
+		quota++;
+	if (_TONE->middle_frequency > 0)
+		quota++;
+	if (_TONE->high_frequency > 0)
+		quota++;
+
+	for (i = 0; i < count; i++) {
+		f1 = sin(2 * M_PI * _TONE->low_frequency * ((*sample) / SAMPLERATE));
+		f2 = sin(2 * M_PI * _TONE->middle_frequency * ((*sample) / SAMPLERATE));
+		f3 = sin(2 * M_PI * _TONE->high_frequency * ((*sample) / SAMPLERATE));
+
+		if (f1 + f2 + f3 != 0)
+			amplitude = (f1 + f2 + f3) / quota * volume * 32767;
+		else
+			amplitude = 0;
+		out[i] = (short)amplitude;
+		(*sample)++;
+	}
+}
+
+static void _bench_first_play(void)
+{
+	tone_plan_t plan;
+	long long begin, first_ns, first_max = 0, first_total = 0, cached_total = 0;
+	int tones = sizeof(TONE_SEGMENT) / sizeof(TONE_SEGMENT[0]);
+	int compiled = 0;
+	int tone;
+
+	for (tone = 0; tone < tones; tone++) {
+		begin = _now_ns();
+		if (_tone_compile(TONE_SEGMENT[tone], MM_SOUND_TONE_NUM / TONE_COLUMN, &plan) != MM_ERROR_NONE)
+			continue;
+		first_ns = _now_ns() - begin;
+		mm_sound_pool_free(&g_plan_pool, plan.step);
+
+		begin = _now_ns();
+		if (_tone_compile(TONE_SEGMENT[tone], MM_SOUND_TONE_NUM / TONE_COLUMN, &plan) == MM_ERROR_NONE)
+			mm_sound_pool_free(&g_plan_pool, plan.step);
+		cached_total += _now_ns() - begin;
+
+		first_total += first_ns;
+		if (first_ns > first_max)
+			first_max = first_ns;
+		compiled++;
+	}
+
+	printf("\n%d built-in tones : first play %.1f us mean, %.1f us max, cached %.1f us mean\n",
+			compiled, first_total / 1e3 / (compiled ? compiled : 1), first_max / 1e3,
+			cached_total / 1e3 / (compiled ? compiled : 1));
+	printf("tone cache : %d loops, arena %d/%d bytes\n", g_cache.count, g_cache.used, TONE_CACHE_ARENA_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	short table_out[BENCH_CHUNK];
+	short sin_out[BENCH_CHUNK];
+	tone_osc_t osc;
+	double sample;
+	long long begin, table_ns, sin_ns;
+	long long total;
+	int seconds = DEFAULT_SECONDS;
+	int chunks, deviation, d;
+	unsigned int t;
+	int n, i;
+
+	if (argc == 3 && strcmp(argv[1], "-n") == 0) {
+		seconds = atoi(argv[2]);
+	} else if (argc != 1) {
+		fprintf(stderr, "usage : %s [-n seconds]\n", argv[0]);
+		return 1;
+	}
+	if (seconds <= 0) {
+		fprintf(stderr, "usage : %s [-n seconds]\n", argv[0]);
+		return 1;
+	}
+
+	_tone_init_table();
+	chunks = (int)((long long)seconds * SAMPLERATE / BENCH_CHUNK);
+	total = (long long)chunks * BENCH_CHUNK;
+
+	printf("%d s of audio per tone, %d samples per chunk\n", seconds, BENCH_CHUNK);
+	printf("%-12s %14s %14s %8s %10s\n", "tone", "table Ms/s", "sin() Ms/s", "speedup", "max dev");
+
+	for (t = 0; t < sizeof(g_bench_tones) / sizeof(g_bench_tones[0]); t++) {
+		memset(&osc, 0, sizeof(osc));
+		begin = _now_ns();
+		for (n = 0; n < chunks; n++)
+			_tone_render(&osc, &g_bench_tones[t].tone, 1.0, table_out, BENCH_CHUNK);
+		table_ns = _now_ns() - begin;
+
+		sample = 0;
+		begin = _now_ns();
+		for (n = 0; n < chunks; n++)
+			_sin_render(&sample, &g_bench_tones[t].tone, 1.0, sin_out, BENCH_CHUNK);
+		sin_ns = _now_ns() - begin;
+
+		/* Accuracy over the first second, both renderers from phase 0 */
+		memset(&osc, 0, sizeof(osc));
+		sample = 0;
+		deviation = 0;
+		for (n = 0; n < SAMPLERATE / BENCH_CHUNK; n++) {
+			_tone_render(&osc, &g_bench_tones[t].tone, 1.0, table_out, BENCH_CHUNK);
+			_sin_render(&sample, &g_bench_tones[t].tone, 1.0, sin_out, BENCH_CHUNK);
+			for (i = 0; i < BENCH_CHUNK; i++) {
+				d = abs(table_out[i] - sin_out[i]);
+				if (d > deviation)
+					deviation = d;
+			}
+		}
+
+		printf("%-12s %14.1f %14.1f %7.1fx %6d LSB\n", g_bench_tones[t].name,
+				total * 1e3 / (table_ns ? table_ns : 1), total * 1e3 / (sin_ns ? sin_ns : 1),
+				(double)sin_ns / (table_ns ? table_ns : 1), deviation);
+	}
+
+	_bench_first_play();
+
+	return 0;
+}
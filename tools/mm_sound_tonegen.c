@@ -0,0 +1,250 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * mm_sound_tonegen : compiles a text tone table into the binary table of the tone plugin
+ *
+ * usage : mm_sound_tonegen <tone_table.txt> <tone_table.bin>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "mm_sound_tone_table.h"
+
+#define MAX_LINE	1024
+#define MAX_TONE	1024
+
+typedef struct {
+	int32_t *rows;
+	int row_count;
+	int row_alloc;
+	mm_sound_tone_table_index_t index[MAX_TONE];
+	int tone_count;
+} tone_table_t;
+
+static int _parse_row(char *line, int32_t *row)
+{
+	char *end = NULL;
+	long value;
+	int i;
+
+	for (i = 0; i < MM_SOUND_TONE_TABLE_COLUMN; i++) {
+		errno = 0;
+		value = strtol(line, &end, 10);
+		if (end == line || errno || value < INT32_MIN || value > INT32_MAX)
+			return -1;
+		row[i] = (int32_t)value;
+		line = end;
+	}
+
+	while (isspace((unsigned char)*line))
+		line++;
+
+	return (*line == '\0') ? 0 : -1;
+}
+
+static int _add_row(tone_table_t *table, const int32_t *row)
+{
+	if (table->row_count == table->row_alloc) {
+		int alloc = table->row_alloc ? table->row_alloc * 2 : 256;
+		int32_t *rows = realloc(table->rows, alloc * MM_SOUND_TONE_TABLE_COLUMN * sizeof(int32_t));
+
+		if (rows == NULL)
+			return -1;
+		table->rows = rows;
+		table->row_alloc = alloc;
+	}
+
+	memcpy(table->rows + table->row_count * MM_SOUND_TONE_TABLE_COLUMN, row, MM_SOUND_TONE_TABLE_COLUMN * sizeof(int32_t));
+	table->row_count++;
+	return 0;
+}
+
+static int _parse(FILE *fp, const char *name, tone_table_t *table)
+{
+	char line[MAX_LINE];
+	int32_t row[MM_SOUND_TONE_TABLE_COLUMN];
+	int current = -1;
+	int lineno = 0;
+	char *p;
+
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+
+		if ((p = strchr(line, '#')) != NULL)
+			*p = '\0';
+		for (p = line; isspace((unsigned char)*p); p++)
+			;
+		if (*p == '\0')
+			continue;
+
+		if (strncmp(p, "tone", 4) == 0 && isspace((unsigned char)p[4])) {
+			char *end = NULL;
+			long id = strtol(p + 4, &end, 10);
+
+			if (end == p + 4 || id < 0 || id >= MAX_TONE) {
+				fprintf(stderr, "%s:%d: invalid tone id\n", name, lineno);
+				return -1;
+			}
+			if (table->index[id].row_count) {
+				fprintf(stderr, "%s:%d: tone %ld is already defined\n", name, lineno, id);
+				return -1;
+			}
+			current = (int)id;
+			table->index[current].first_row = table->row_count;
+			if (current >= table->tone_count)
+				table->tone_count = current + 1;
+			continue;
+		}
+
+		if (current < 0) {
+			fprintf(stderr, "%s:%d: row outside of a tone\n", name, lineno);
+			return -1;
+		}
+		if (_parse_row(p, row) < 0) {
+			fprintf(stderr, "%s:%d: a row needs %d integers\n", name, lineno, MM_SOUND_TONE_TABLE_COLUMN);
+			return -1;
+		}
+		if (table->index[current].first_row + table->index[current].row_count != (uint32_t)table->row_count) {
+			fprintf(stderr, "%s:%d: rows of tone %d are not contiguous\n", name, lineno, current);
+			return -1;
+		}
+		if (_add_row(table, row) < 0) {
+			fprintf(stderr, "out of memory\n");
+			return -1;
+		}
+		table->index[current].row_count++;
+	}
+
+	return 0;
+}
+
+static int _validate(const tone_table_t *table)
+{
+	int id, i;
+
+	for (id = 0; id < table->tone_count; id++) {
+		const mm_sound_tone_table_index_t *index = &table->index[id];
+		const int32_t *row = table->rows + index->first_row * MM_SOUND_TONE_TABLE_COLUMN;
+
+		if (index->row_count == 0)
+			continue;
+
+		for (i = 0; i < (int)index->row_count; i++, row += MM_SOUND_TONE_TABLE_COLUMN) {
+			if (row[0] == -1) {		/* end of the tone set */
+				if (row[5] < 0 || row[5] >= (int32_t)index->row_count) {
+					fprintf(stderr, "tone %d: row %d jumps out of the tone\n", id, i);
+					return -1;
+				}
+				continue;
+			}
+			if (row[0] < 0 || row[1] < 0 || row[2] < 0 || row[3] < -1 || row[4] < 0 ||
+				row[5] < 0 || row[5] >= (int32_t)index->row_count) {
+				fprintf(stderr, "tone %d: row %d is invalid\n", id, i);
+				return -1;
+			}
+		}
+
+		row -= MM_SOUND_TONE_TABLE_COLUMN;
+		if (row[0] != -1) {
+			fprintf(stderr, "tone %d: the last row must start with -1\n", id);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int _write(FILE *fp, const tone_table_t *table)
+{
+	mm_sound_tone_table_header_t header;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = MM_SOUND_TONE_TABLE_MAGIC;
+	header.version = MM_SOUND_TONE_TABLE_VERSION;
+	header.column = MM_SOUND_TONE_TABLE_COLUMN;
+	header.tone_count = table->tone_count;
+	header.row_count = table->row_count;
+	header.index_offset = sizeof(header);
+	header.row_offset = header.index_offset + table->tone_count * sizeof(mm_sound_tone_table_index_t);
+
+	if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+		fwrite(table->index, sizeof(mm_sound_tone_table_index_t), table->tone_count, fp) != (size_t)table->tone_count ||
+		fwrite(table->rows, MM_SOUND_TONE_TABLE_COLUMN * sizeof(int32_t), table->row_count, fp) != (size_t)table->row_count)
+		return -1;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static tone_table_t table;
+	FILE *in = NULL;
+	FILE *out = NULL;
+	int ret = 1;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage : %s <tone_table.txt> <tone_table.bin>\n", argv[0]);
+		return 1;
+	}
+
+	in = fopen(argv[1], "r");
+	if (in == NULL) {
+		fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+
+	if (_parse(in, argv[1], &table) < 0 || _validate(&table) < 0)
+		goto cleanup;
+
+	if (table.tone_count == 0) {
+		fprintf(stderr, "%s: no tone is defined\n", argv[1]);
+		goto cleanup;
+	}
+
+	out = fopen(argv[2], "wb");
+	if (out == NULL) {
+		fprintf(stderr, "%s: %s\n", argv[2], strerror(errno));
+		goto cleanup;
+	}
+
+	if (_write(out, &table) < 0 || fclose(out) != 0) {
+		out = NULL;
+		fprintf(stderr, "%s: write failed\n", argv[2]);
+		remove(argv[2]);
+		goto cleanup;
+	}
+	out = NULL;
+
+	printf("%s: %d tones, %d rows\n", argv[2], table.tone_count, table.row_count);
+	ret = 0;
+
+cleanup:
+	if (out)
+		fclose(out);
+	fclose(in);
+	free(table.rows);
+	return ret;
+}
@@ -0,0 +1,158 @@
+/*
+ * libmm-sound
+ *
+ * Copyright (c) 2000 - 2011 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Seungbae Shin <seungbae.shin@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * mm_sound_wavbench : measures the WAV indexer over a corpus
+ *
+ * usage : mm_sound_wavbench [-n passes] <directory>
+ *
+ * Every .wav file of the directory is mapped read only, then indexed 'passes'
+ * times. Files which fail to index are listed once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <mm_error.h>
+
+#include "mm_sound_wav.h"
+
+#define DEFAULT_PASSES	1000
+#define MAX_FILE		65536
+
+typedef struct {
+	char *name;
+	void *image;
+	size_t size;
+} image_t;
+
+static long long _now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int _map(const char *path, image_t *image)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+
+	if (fd == -1)
+		return -1;
+	if (fstat(fd, &st) == -1 || st.st_size == 0 || st.st_size > UINT32_MAX) {
+		close(fd);
+		return -1;
+	}
+	image->image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (image->image == MAP_FAILED)
+		return -1;
+	image->size = st.st_size;
+	/* Measure the indexer, not the page faults */
+	madvise(image->image, image->size, MADV_WILLNEED);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static image_t images[MAX_FILE];
+	mm_sound_wav_info_t info;
+	struct dirent *ent;
+	char path[4096];
+	DIR *dir;
+	long long begin, elapsed;
+	unsigned long long bytes = 0;
+	int passes = DEFAULT_PASSES;
+	int count = 0, failed = 0;
+	int argi = 1;
+	int i, n;
+	size_t length;
+
+	if (argc == 4 && strcmp(argv[1], "-n") == 0) {
+		passes = atoi(argv[2]);
+		argi = 3;
+	}
+	if (argc - argi != 1 || passes <= 0) {
+		fprintf(stderr, "usage : %s [-n passes] <directory>\n", argv[0]);
+		return 1;
+	}
+
+	dir = opendir(argv[argi]);
+	if (dir == NULL) {
+		fprintf(stderr, "%s: %s\n", argv[argi], strerror(errno));
+		return 1;
+	}
+	while ((ent = readdir(dir)) != NULL && count < MAX_FILE) {
+		length = strlen(ent->d_name);
+		if (length <= 4 || strcasecmp(ent->d_name + length - 4, ".wav") != 0)
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", argv[argi], ent->d_name);
+		if (_map(path, &images[count]) < 0) {
+			fprintf(stderr, "%s: cannot map\n", path);
+			continue;
+		}
+		images[count].name = strdup(ent->d_name);
+		bytes += images[count].size;
+		count++;
+	}
+	closedir(dir);
+
+	if (count == 0) {
+		fprintf(stderr, "%s: no WAV file\n", argv[argi]);
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (mm_sound_wav_index(images[i].image, images[i].size, &info) != MM_ERROR_NONE) {
+			printf("  not indexed : %s\n", images[i].name);
+			failed++;
+		}
+	}
+
+	begin = _now_ns();
+	for (n = 0; n < passes; n++) {
+		for (i = 0; i < count; i++)
+			mm_sound_wav_index(images[i].image, images[i].size, &info);
+	}
+	elapsed = _now_ns() - begin;
+
+	printf("%d files (%llu bytes), %d not indexed, %d passes\n", count, bytes, failed, passes);
+	printf("%.1f ns per file, %.0f files/s\n",
+			(double)elapsed / ((double)count * passes),
+			(double)count * passes * 1e9 / (elapsed ? elapsed : 1));
+
+	for (i = 0; i < count; i++) {
+		munmap(images[i].image, images[i].size);
+		free(images[i].name);
+	}
+	return 0;
+}